@@ -6,7 +6,7 @@ in vec3 Normal;     // Surface normal for lighting
 
 out vec4 FragColor;
 
-uniform sampler2D heightMap;  // The height field texture
+uniform sampler2D displacementMap;  // Packed displacement (Dx, height, Dz, Jacobian)
 
 uniform vec3 lightPosition;   // Position of the light source
 uniform vec3 lightColor;      // Light color
@@ -15,7 +15,7 @@ uniform vec3 waterColorShallow; // Shallow water color
 
 void main() {
     // Get height value from the height map texture
-    float height = texture(heightMap, TexCoord).r;
+    float height = texture(displacementMap, TexCoord).g;
 
     // Map height to a color: interpolate between deep blue and shallow blue based on the height
     vec3 waterColor = mix(waterColorDeep, waterColorShallow, height);
@@ -28,6 +28,12 @@ void main() {
     // Apply diffuse lighting to the water color
     vec3 resultColor = waterColor * diff * lightColor;
 
+    // Foam where the choppy displacement compresses or folds the surface,
+    // i.e. where the Jacobian of the horizontal displacement drops towards 0
+    float jacobian = texture(displacementMap, TexCoord).a;
+    float foam = 1.0 - smoothstep(0.0, 0.6, jacobian);
+    resultColor = mix(resultColor, lightColor * diff, foam);
+
     // Output final fragment color
     FragColor = vec4(resultColor, 1.0);
 }
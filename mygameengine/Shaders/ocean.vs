@@ -3,8 +3,11 @@
 layout(location = 0) in vec3 aPosition;  // The vertex position (X, Y, Z)
 layout(location = 1) in vec2 aTexCoord;  // The texture coordinates (for heightfield lookup)
 
-uniform sampler2D heightMap;  // The height field texture
+uniform sampler2D displacementMap;  // Packed displacement (Dx, height, Dz, Jacobian)
 uniform float heightScale;    // Scale factor to control the height displacement
+uniform float choppiness;     // Scale of the horizontal (choppy) displacement
+uniform sampler2D slopeMap;   // Height gradient (dh/dx, dh/dz) from the FFT
+uniform float slopeScale;     // Converts the patch slopes to world space
 
 uniform mat4 view;            // Camera view matrix
 uniform mat4 projection;      // Camera projection matrix
@@ -15,18 +18,22 @@ out vec2 TexCoord;   // Texture coordinates for sampling
 out vec3 Normal;     // Surface normal for lighting calculations
 
 void main() {
-    // Get the height value from the texture using the texture coordinates
-    float height = texture(heightMap, aTexCoord).r;
+    // Get the displacement from the texture using the texture coordinates
+    vec3 displacement = texture(displacementMap, aTexCoord).rgb;
 
-    // Displace the vertex's Y position based on the height and a scale factor
+    // Displace the vertex: Y by the height, XZ towards the crests for choppy
+    // waves, both by the same scale factor. D = -i K/|K| h points away from
+    // the crests with FFTW's e^(+iKx) inverse transform, hence the minus.
     vec3 displacedPosition = aPosition;
-    displacedPosition.y += height * heightScale;
+    displacedPosition.y += displacement.g * heightScale;
+    displacedPosition.xz -= displacement.rb * choppiness * heightScale;
 
     // Compute the final world-space position of the vertex
     FragPos = vec3(model * vec4(displacedPosition, 1.0));
 
-    // Calculate approximate normals (assumes flat grid, for better results you'd want to calculate normals in a more advanced way)
-    Normal = normalize(vec3(0.0, 1.0, 0.0));  // Assuming normals point upwards, modify if using actual normals
+    // Normal from the exact spectral slopes, no neighbouring texels needed
+    vec2 slope = texture(slopeMap, aTexCoord).rg * slopeScale;
+    Normal = mat3(model) * normalize(vec3(-slope.x, 1.0, -slope.y));
 
     // Pass the displaced position to the next stage
     gl_Position = projection * view * vec4(FragPos, 1.0);
@@ -0,0 +1,83 @@
+#version 330 core
+
+layout(location = 0) in vec3 aPosition;  // The vertex position (X, Y, Z), metres
+
+// Two layers per cascade: packed displacement (Dx, height, Dz, Jacobian) and
+// the height gradient (dh/dx, dh/dz) of its two most recent results. A
+// cascade of size N only fills the N x N corner of its layers, so the
+// texels are wrapped and filtered here.
+uniform sampler2DArray displacementMaps;
+uniform sampler2DArray slopeMaps;
+uniform int cascadeCount;
+uniform int cascadeSize[4];   // N of each cascade
+uniform float patchSize[4];   // L of each cascade, metres
+uniform int olderLayer[4];    // layers of the two results of each cascade
+uniform int newerLayer[4];
+uniform float cascadeBlend[4];  // 0 = older result, 1 = newer result
+
+uniform float heightScale;    // Scale factor to control the height displacement
+uniform float choppiness;     // Scale of the horizontal (choppy) displacement
+
+uniform mat4 view;            // Camera view matrix
+uniform mat4 projection;      // Camera projection matrix
+uniform mat4 model;           // Model matrix for ocean transformation
+
+out vec3 FragPos;    // World-space position of the fragment
+out vec3 Normal;     // Surface normal for lighting calculations
+out float Height;    // Summed height, for the water colour
+out float Foam;      // Foam coverage from the summed Jacobians
+
+// Bilinear lookup with the patch repeating every `size` texels
+vec4 sampleWrapped(sampler2DArray map, vec2 uv, int size, int layer) {
+    vec2 texel = uv * float(size) - 0.5;
+    vec2 base = floor(texel);
+    vec2 f = texel - base;
+    ivec2 a = ivec2(mod(base, float(size)));
+    ivec2 b = ivec2(mod(base + 1.0, float(size)));
+
+    vec4 s00 = texelFetch(map, ivec3(a.x, a.y, layer), 0);
+    vec4 s10 = texelFetch(map, ivec3(b.x, a.y, layer), 0);
+    vec4 s01 = texelFetch(map, ivec3(a.x, b.y, layer), 0);
+    vec4 s11 = texelFetch(map, ivec3(b.x, b.y, layer), 0);
+    return mix(mix(s00, s10, f.x), mix(s01, s11, f.x), f.y);
+}
+
+void main() {
+    vec3 displacement = vec3(0.0);
+    vec2 slope = vec2(0.0);
+    float jacobianOffset = 0.0;
+
+    // Each cascade holds its own band of the spectrum, so the fields add up
+    for (int i = 0; i < cascadeCount; ++i) {
+        vec2 uv = aPosition.xz / patchSize[i];
+        int size = cascadeSize[i];
+        float blend = cascadeBlend[i];
+        // cascades updated below the frame rate blend their last two results
+        vec4 d = mix(sampleWrapped(displacementMaps, uv, size, olderLayer[i]),
+                     sampleWrapped(displacementMaps, uv, size, newerLayer[i]),
+                     blend);
+        vec2 s = mix(sampleWrapped(slopeMaps, uv, size, olderLayer[i]).rg,
+                     sampleWrapped(slopeMaps, uv, size, newerLayer[i]).rg,
+                     blend);
+        displacement += d.rgb;
+        slope += s;
+        // to first order the compressions of the bands add up as well
+        jacobianOffset += d.a - 1.0;
+    }
+
+    // D = -i K/|K| h points away from the crests, hence the minus
+    vec3 displacedPosition = aPosition;
+    displacedPosition.y += displacement.g * heightScale;
+    displacedPosition.xz -= displacement.rb * choppiness * heightScale;
+
+    FragPos = vec3(model * vec4(displacedPosition, 1.0));
+
+    // Positions are in metres, so only the height scale applies to the slopes
+    slope *= heightScale;
+    Normal = mat3(model) * normalize(vec3(-slope.x, 1.0, -slope.y));
+
+    Height = displacement.g;
+    Foam = 1.0 - smoothstep(0.0, 0.6, 1.0 + jacobianOffset);
+
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
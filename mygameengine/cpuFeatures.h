@@ -0,0 +1,14 @@
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+// Instruction sets usable on this machine (CPU support and OS register state)
+struct CpuFeatures {
+  bool avx2 = false;  // AVX2 + FMA3
+  bool avx512 = false;  // AVX-512F
+  bool f16c = false;  // fp16 <-> fp32 conversions
+};
+
+// Detected once on first call
+const CpuFeatures &cpuFeatures();
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef DISPERSION_H
+#define DISPERSION_H
+
+// Dispersion relation w(k) linking a wave's wavenumber to its frequency
+enum DispersionModel {
+  DISPERSION_DEEP_WATER,        // w = sqrt(g k)
+  DISPERSION_FINITE_DEPTH,      // w = sqrt(g k tanh(k h))
+  DISPERSION_CAPILLARY_GRAVITY, // w = sqrt((g k + sigma / rho k^3) tanh(k h))
+};
+
+struct DispersionParams {
+  DispersionModel model = DISPERSION_DEEP_WATER;
+  float depth = 100.0f;           // h, metres
+  float surfaceTension = 0.074f;  // sigma, N/m (clean water)
+  float density = 1000.0f;        // rho, kg/m^3
+};
+
+// Angular frequency of a wave with wavenumber k (rad/m) under gravity g
+float dispersionOmega(const DispersionParams &params, float g, float k);
+
+// Snaps w down to a multiple of the base frequency 2 pi / T, so the wave
+// completes a whole number of cycles in T; T <= 0 leaves w as it is
+float loopOmega(float omega, float loopPeriod);
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef FIELD_KERNELS_H
+#define FIELD_KERNELS_H
+
+// Post-FFT pass over one row of the spatial fields. The raw FFT outputs are
+// read once and written once, already normalized and sign corrected:
+//   displacement[x] = (Dx, height, Dz, J)   RGBA
+//   slope[x]        = (dh/dx, dh/dz)        RG
+// J is the Jacobian of the horizontal displacement, from central differences
+// of Dx and Dz. It drops towards (and below) zero where the choppy waves fold
+// over, which is where the fragment shader puts foam.
+struct PackFieldsRow {
+  int n;       // texels per row, neighbours wrap around (periodic patch)
+  int stride;  // floats between consecutive samples of the inputs (1 or 2)
+
+  // row z of each FFT output channel
+  const float *height;
+  const float *displacementX;
+  const float *displacementZ;
+  const float *slopeX;
+  const float *slopeZ;
+  // rows z - 1 and z + 1 of the displacements, for the z derivatives
+  const float *displacementXUp, *displacementXDown;
+  const float *displacementZUp, *displacementZDown;
+
+  // normalization (1 / N^2) times the checkerboard sign of even / odd
+  // columns of this row; the neighbours of a column use the other entry
+  float scale[2];
+  // converts a central difference of the normalized displacement into the
+  // derivative of the rendered displacement
+  float jacobianScale;
+
+  float *displacement;  // n RGBA texels
+  float *slope;         // n RG texels
+};
+
+typedef void (*PackFieldsFn)(const PackFieldsRow &row);
+
+void packFieldsScalar(const PackFieldsRow &row);
+// 8 texels per iteration, needs AVX2 + FMA. Falls back to the scalar kernel
+// for strided (complex) inputs and the wrapping edge columns.
+void packFieldsAVX2(const PackFieldsRow &row);
+
+// Columns [begin, end) only, shared by the scalar kernel and the SIMD tails
+void packFieldsRange(const PackFieldsRow &row, int begin, int end);
+
+// Widest kernel the CPU supports
+PackFieldsFn selectPackFieldsKernel();
+
+#endif
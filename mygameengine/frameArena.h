@@ -0,0 +1,87 @@
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <vector>
+
+// Every buffer the simulation touches per frame is either persistent (the
+// spectra, tables and staging of a Wave, from PersistentPool) or lives for
+// one frame (from a FrameArena), so a steady-state frame makes no heap
+// allocation at all. heapAllocationCount() checks that: it counts every
+// operator new of the process plus the blocks taken by the two allocators.
+
+// Alignment of everything handed out below: a cache line, and enough for
+// AVX-512 loads
+const size_t ARENA_ALIGNMENT = 64;
+
+// Heap allocations since startup; a frame that moves it allocated
+unsigned long long heapAllocationCount();
+
+// Counted, ARENA_ALIGNMENT aligned heap blocks
+void *alignedAlloc(size_t bytes);
+void alignedFree(void *block);
+
+// Bump allocator for data that lives until the next reset(), typically one
+// frame. Allocations past the end of the block go to the heap; the next
+// reset() then replaces the block by one of the high-water size, so after
+// the first frames the arena settles and never allocates again. Not thread
+// safe: fill it from one thread, then share the results.
+class FrameArena {
+ public:
+  explicit FrameArena(size_t initialBytes = 0);
+  ~FrameArena();
+
+  void *allocate(size_t bytes);
+  // Storage for count T, not constructed
+  template <class T>
+  T *allocate(size_t count) {
+    return static_cast<T *>(allocate(count * sizeof(T)));
+  }
+
+  // Forgets everything allocated so far
+  void reset();
+
+  size_t capacity() const { return capacity_; }
+  size_t used() const { return used_; }
+
+ private:
+  char *block_ = nullptr;
+  size_t capacity_ = 0;
+  size_t used_ = 0;
+  size_t overflowBytes_ = 0;
+  std::vector<void *> overflow_;  // heap blocks taken since the last reset
+
+  FrameArena(const FrameArena &) = delete;
+  FrameArena &operator=(const FrameArena &) = delete;
+};
+
+// Long-lived aligned buffers: spectra, dispersion tables, field staging.
+// Released blocks are kept by size and handed out again, so rebuilding a
+// Wave or toggling one of its modes reuses memory instead of going back to
+// the heap. Thread safe.
+class PersistentPool {
+ public:
+  ~PersistentPool();
+
+  void *allocate(size_t bytes);
+  // Storage for count T, not constructed
+  template <class T>
+  T *allocate(size_t count) {
+    return static_cast<T *>(allocate(count * sizeof(T)));
+  }
+  // Takes back a block of allocate(); nullptr is ignored
+  void release(void *block);
+  // Returns the cached blocks to the heap
+  void trim();
+
+  static PersistentPool &shared();
+
+ private:
+  std::mutex mutex;
+  std::map<void *, size_t> live;           // block -> bytes
+  std::multimap<size_t, void *> released;  // bytes -> block
+};
+
+#endif
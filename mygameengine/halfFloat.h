@@ -0,0 +1,27 @@
+#ifndef HALF_FLOAT_H
+#define HALF_FLOAT_H
+
+#include <cstdint>
+
+// IEEE binary16 conversions for the half precision storage mode. Spectra and
+// fields are only stored as fp16; every load converts to fp32 and all the
+// arithmetic stays in fp32. Rounding is to nearest even, as F16C does, so the
+// scalar and F16C kernels give identical results.
+
+uint16_t floatToHalf(float value);
+float halfToFloat(uint16_t value);
+
+typedef void (*FloatToHalfFn)(const float *in, int count, uint16_t *out);
+typedef void (*HalfToFloatFn)(const uint16_t *in, int count, float *out);
+
+void floatToHalfScalar(const float *in, int count, uint16_t *out);
+void halfToFloatScalar(const uint16_t *in, int count, float *out);
+// 8 values per instruction, needs F16C
+void floatToHalfF16C(const float *in, int count, uint16_t *out);
+void halfToFloatF16C(const uint16_t *in, int count, float *out);
+
+// F16C kernels where the CPU has them
+FloatToHalfFn selectFloatToHalfKernel();
+HalfToFloatFn selectHalfToFloatKernel();
+
+#endif
@@ -0,0 +1,120 @@
+#ifndef HEIGHT_QUERY_H
+#define HEIGHT_QUERY_H
+
+#include <atomic>
+#include <glm/glm.hpp>
+#include <span>
+
+// CPU side height queries (buoyancy, gameplay) against the fields the
+// simulation finished last. Every completed frame publishes its height
+// channel into one of a few preallocated slots; readers pin a slot with an
+// atomic count, so neither side locks or allocates and the simulation never
+// writes a field that is being read.
+
+// Heights of one completed frame, periodic in both directions. The texel
+// coordinate of world position x is x * texelsPerUnit + offset, texel
+// centers on integers, matching the GPU's GL_REPEAT lookups of the field.
+struct HeightField {
+  int n = 0;  // texels per side, a power of two
+  int log2n = 0;
+  const float *heights = nullptr;  // n x n, world units, row z then column x
+  float texelsPerUnit = 1.0f;
+  float offset = 0.0f;
+};
+
+enum HeightFilter {
+  HEIGHT_FILTER_BILINEAR,  // 4 texels, what the renderer shows
+  HEIGHT_FILTER_BICUBIC,   // 16 texels, Catmull-Rom, smooth slopes
+};
+
+// Samples count world positions (x, z) of the field into out
+typedef void (*SampleHeightsFn)(const HeightField &field,
+                                const glm::vec2 *positions, int count,
+                                float *out);
+
+void sampleHeightsBilinearScalar(const HeightField &field,
+                                 const glm::vec2 *positions, int count,
+                                 float *out);
+void sampleHeightsBicubicScalar(const HeightField &field,
+                                const glm::vec2 *positions, int count,
+                                float *out);
+// 8 queries per iteration with hardware gathers, needs AVX2 + FMA
+void sampleHeightsBilinearAVX2(const HeightField &field,
+                               const glm::vec2 *positions, int count,
+                               float *out);
+void sampleHeightsBicubicAVX2(const HeightField &field,
+                              const glm::vec2 *positions, int count,
+                              float *out);
+
+// Widest kernel of the filter the CPU supports
+SampleHeightsFn selectSampleHeightsKernel(HeightFilter filter);
+
+struct HeightFieldSlot {
+  HeightField field;
+  float *storage = nullptr;
+  std::atomic<int> readers{0};
+};
+
+// Pins one published field; the store does not rewrite it while the
+// snapshot lives. Meant to be held for a batch of queries, not kept across
+// frames: every snapshot held back keeps the simulation from using a slot.
+class HeightSnapshot {
+ public:
+  HeightSnapshot() = default;
+  HeightSnapshot(HeightSnapshot &&other) noexcept;
+  HeightSnapshot &operator=(HeightSnapshot &&other) noexcept;
+  ~HeightSnapshot() { release(); }
+
+  void release();
+  bool isValid() const { return slot_ != nullptr; }
+  // valid snapshots only
+  const HeightField &field() const { return slot_->field; }
+
+  // heights[i] = height at positions[i], for as many as both spans hold;
+  // false (heights untouched) if the snapshot is empty
+  bool sample(std::span<const glm::vec2> positions, std::span<float> heights,
+              HeightFilter filter = HEIGHT_FILTER_BILINEAR) const;
+
+ private:
+  friend class HeightFieldStore;
+  HeightFieldSlot *slot_ = nullptr;
+
+  HeightSnapshot(const HeightSnapshot &) = delete;
+  HeightSnapshot &operator=(const HeightSnapshot &) = delete;
+};
+
+// Latest completed height field of one simulation. One writer (the thread
+// finishing frames), any number of readers on any thread.
+class HeightFieldStore {
+ public:
+  // the current field, the one being written and one still being read
+  static const int SLOTS = 3;
+
+  ~HeightFieldStore() { clear(); }
+
+  // Slots for n x n fields (from PersistentPool); drops the current field
+  void resize(int n);
+  // Drops the current field and frees the slots, once no snapshot of them
+  // is left
+  void clear();
+
+  // Writer: storage for the next field, or nullptr if every slot but the
+  // current one is still being read (that frame is then not published)
+  float *beginFrame();
+  // Writer: makes the field written since beginFrame() the current one
+  void publish(float texelsPerUnit, float offset);
+
+  // Any thread: the current field, empty before the first publish
+  HeightSnapshot acquire() const;
+
+ private:
+  mutable HeightFieldSlot slots[SLOTS];
+  std::atomic<int> current{-1};
+  int writing = -1;
+  int n = 0;
+};
+
+// Times 100k queries of each filter and kernel against an n x n field
+void benchmarkHeightQueries(int n);
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef LOOP_CACHE_H
+#define LOOP_CACHE_H
+
+#include <cstdint>
+#include <functional>
+
+#include "mappedFile.h"
+
+#define LOOP_CACHE_MAGIC "OLPC"
+#define LOOP_CACHE_VERSION 1
+
+// Fields stored per texel: the packed RGBA displacement (Dx, height, Dz, J)
+// followed by the RG slopes, the layout of Wave's staging buffer
+const int LOOP_CACHE_CHANNELS = 6;
+
+// File layout: header, then the dequantization parameters of every frame,
+// then the frames themselves. Each frame holds N x N x 4 then N x N x 2
+// int16 values, quantized per frame and channel:
+//   value = offset[c] + scale[c] * q
+struct LoopCacheHeader {
+  char magic[4];
+  uint32_t version;
+  int32_t n;
+  int32_t frames;
+  float period;  // seconds, frame k is the ocean at t = k * period / frames
+  uint32_t reserved[3];
+};
+
+struct LoopCacheFrameParams {
+  float scale[LOOP_CACHE_CHANNELS];
+  float offset[LOOP_CACHE_CHANNELS];
+};
+
+// Baked animation of an ocean that repeats with period T. Playback maps the
+// file and blends the two frames around t, no spectrum or FFT work at all.
+class LoopCache {
+ public:
+  // Evaluates `frames` equally spaced times over one period through
+  // evaluate(t), which returns N x N x 6 floats in the staging layout, and
+  // writes them to path. Reports bake time and file size.
+  static bool bake(const char *path, int n, int frames, float period,
+                   const std::function<const float *(double t)> &evaluate);
+
+  // false if the file is missing, corrupt or baked for another grid size
+  bool open(const char *path, int n);
+  bool isOpen() const { return file.isOpen(); }
+  float period() const { return header->period; }
+  int frames() const { return header->frames; }
+
+  // Fills out (N x N x 6 floats, staging layout) with the ocean at time t,
+  // interpolated between the two closest frames
+  void sample(double t, float *out);
+
+ private:
+  MappedFile file;
+  const LoopCacheHeader *header = nullptr;
+  const LoopCacheFrameParams *params = nullptr;
+  const int16_t *frameData = nullptr;
+
+  // playback cost, reported every LOOP_CACHE_REPORT_INTERVAL frames
+  double sampleSeconds = 0.0;
+  int sampleCount = 0;
+};
+
+#endif
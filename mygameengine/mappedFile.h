@@ -0,0 +1,90 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+
+// Read-only memory mapping of a whole file. Pages are loaded by the OS on
+// first touch, so opening even a large cache is instant.
+class MappedFile {
+ public:
+  MappedFile() = default;
+  ~MappedFile();
+
+  // false if the file is missing or cannot be mapped
+  bool open(const char *path);
+  void close();
+
+  bool isOpen() const { return data_ != nullptr; }
+  const void *data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  void *data_ = nullptr;
+  size_t size_ = 0;
+#ifdef _WIN32
+  void *file_ = nullptr;  // HANDLE
+  void *mapping_ = nullptr;
+#endif
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+};
+
+// Mapped byte range of a ScratchFile; unmapping it lets the OS write the
+// pages back and drop them
+class FileView {
+ public:
+  FileView() = default;
+  FileView(FileView &&other) noexcept;
+  FileView &operator=(FileView &&other) noexcept;
+  ~FileView() { unmap(); }
+
+  void unmap();
+  bool isMapped() const { return data_ != nullptr; }
+  void *data() const { return data_; }
+
+ private:
+  friend class ScratchFile;
+  void *base_ = nullptr;  // start of the mapping, aligned down from data_
+  size_t length_ = 0;
+  void *data_ = nullptr;
+
+  FileView(const FileView &) = delete;
+  FileView &operator=(const FileView &) = delete;
+};
+
+// Read-write file of a fixed size that is only ever mapped a window at a
+// time, for data larger than memory: only the windows currently mapped are
+// resident, however large the file
+class ScratchFile {
+ public:
+  ScratchFile() = default;
+  ~ScratchFile();
+
+  // Creates path (or truncates it) with `size` bytes; false on failure
+  bool create(const char *path, size_t size);
+  // Opens an existing file for reading and writing
+  bool open(const char *path);
+  void close();
+
+  bool isOpen() const { return size_ != 0; }
+  size_t size() const { return size_; }
+
+  // Maps bytes [offset, offset + length); not mapped on failure. Views
+  // stay valid until unmapped, independently of each other and the file.
+  FileView map(size_t offset, size_t length);
+
+ private:
+  size_t size_ = 0;
+#ifdef _WIN32
+  void *file_ = nullptr;  // HANDLE
+  void *mapping_ = nullptr;
+#else
+  int fd_ = -1;
+#endif
+
+  ScratchFile(const ScratchFile &) = delete;
+  ScratchFile &operator=(const ScratchFile &) = delete;
+};
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef OCEAN_CASCADES_H
+#define OCEAN_CASCADES_H
+
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "wave.h"
+
+// Upper bound on cascades, matches the uniform arrays in oceanCascades.vs
+const int MAX_OCEAN_CASCADES = 4;
+
+struct CascadeConfig {
+  int n;            // grid resolution
+  float patchSize;  // metres, pick sizes that are not near multiples of each
+                    // other so their repeats do not line up
+  // Hz, 0 simulates every frame. Long waves barely move between frames, so
+  // large patches can run at a fraction of the frame rate.
+  float updateRate = 0.0f;
+};
+
+// Ocean built from 2-4 Wave simulations of different patch sizes, each
+// owning one band of the spectrum. Every cascade runs its own small FFT;
+// the vertex shader sums them from two texture arrays over a mesh much larger
+// than any single patch, so no single tile repeats visibly.
+class OceanCascades {
+ public:
+  // cascades go from the largest patch to the smallest
+  OceanCascades(const std::vector<CascadeConfig> &configs,
+                const SpectrumParams &spectrum = SpectrumParams(),
+                int meshResolution = 512, float meshSize = 2000.0f);
+  ~OceanCascades();
+
+  void setCamera(Camera *camera) { this->camera = camera; }
+  void setShader(Shader *shader);
+  void setChoppiness(float lambda);
+  // fp16 spectra and fields for every cascade, call before setShader
+  void setHalfPrecision(bool enabled);
+
+  void update();
+  // Advances the clock and adds the due cascade updates as tasks, cascades
+  // interleaved; render() once the graph has run
+  void scheduleFrame(FrameGraph &graph);
+  void render();
+
+  int cascadeCount() const { return int(cascades.size()); }
+  // Do not resize a cascade: its texture layers are sized at construction
+  Wave *cascade(int i) { return cascades[i]; }
+
+ private:
+  std::vector<Wave *> cascades;
+
+  // Cascades with an update rate keep two results in their two layers: the
+  // ocean at olderTime and one period later at newerTime. Rendering blends
+  // them by where the frame falls in between, so the slow bands neither
+  // pop nor lag.
+  struct CascadeSchedule {
+    float period = 0.0f;  // 1 / updateRate, 0 = every frame
+    double olderTime = 0.0;
+    double newerTime = 0.0;
+    int newerSlot = 0;  // layer 2 i + newerSlot holds newerTime
+    bool started = false;
+    TaskId lastTask = -1;  // last task of this cascade in the frame graph
+  };
+  std::vector<CascadeSchedule> schedules;
+
+  // simulation cost, reported every CASCADE_REPORT_INTERVAL frames
+  double simulationSeconds = 0.0;
+  int simulatedFrames = 0;
+  int cascadeUpdates = 0;
+  int maxN = 0;  // layer size of the texture arrays
+  float choppiness = 1.0f;
+
+  double lastFrame = 0.0;
+  double timeStep = 0.0;
+  // set while scheduleFrame queues the cascade updates
+  FrameGraph *frameGraph = nullptr;
+
+  Camera *camera = nullptr;
+  Shader *shader = nullptr;
+
+  std::vector<glm::vec3> vertices;
+  std::vector<unsigned int> indices;
+  GLuint VAO = 0, VBO = 0, EBO = 0;
+  // two layers per cascade, smaller cascades fill the lower left corner
+  GLuint displacementMaps = 0;
+  GLuint slopeMaps = 0;
+
+  void createSurface(int resolution, float size);
+  void initRenderParams();
+  void simulateCascade(int i, double t, int slot);
+  void uploadCascade(int i, int slot);
+  void advanceClock();
+  void scheduleCascade(int i, double now);
+
+  OceanCascades(const OceanCascades &) = delete;
+  OceanCascades &operator=(const OceanCascades &) = delete;
+};
+
+#endif
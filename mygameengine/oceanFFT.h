@@ -0,0 +1,101 @@
+#ifndef OCEAN_FFT_H
+#define OCEAN_FFT_H
+
+#include <fftw3.h>
+
+// File the FFTW planner wisdom is cached in (relative to the working
+// directory, like the results/ images)
+#define FFTW_WISDOM_FILE "fftw_wisdom.dat"
+
+// Layout of the spectrum handed to the FFT
+enum FFTMode {
+  // full N x N spectrum, centered (bin j holds n = j - N/2), complex output.
+  // The centering flips the sign of every other output sample.
+  FFT_COMPLEX,
+  // N x (N/2 + 1) half spectrum in FFTW order (bin j holds n = j, row i holds
+  // m = i or i - N), real output. Only valid for Hermitian spectra.
+  FFT_HALF_COMPLEX,
+};
+
+// Implementation of the transforms
+enum FFTBackend {
+  FFT_BACKEND_FFTW,
+  // the in-engine Stockham FFT (stockhamFFT.h), sizes 64 - 1024 only; other
+  // sizes fall back to FFTW
+  FFT_BACKEND_STOCKHAM,
+};
+
+struct StockhamPasses;
+
+// Owns the buffers and the plan for the 2D inverse FFTs of the ocean spectra.
+// All channels (height, displacements, ...) go through one batched plan.
+// Planning is done once on construction; the first run on a machine pays for
+// FFTW_MEASURE / FFTW_PATIENT, later runs reuse the wisdom saved on disk.
+// With threads > 1 the plan is split across FFTW's own threads.
+class OceanFFT {
+ public:
+  OceanFFT(int n, int channels = 1, FFTMode mode = FFT_HALF_COMPLEX,
+           unsigned planFlags = FFTW_MEASURE, int threads = 1);
+  ~OceanFFT();
+
+  FFTMode mode() const { return mode_; }
+  FFTBackend backend() const { return backend_; }
+  int channels() const { return channels_; }
+  // number of complex bins per spectrum row (N or N/2 + 1)
+  int spectrumWidth() const { return width_; }
+
+  // frequency domain input (N x spectrumWidth()) of a channel, filled by the
+  // caller every frame. Clobbered by execute() in FFT_HALF_COMPLEX mode.
+  fftwf_complex *input(int channel = 0) {
+    return in_ + channel * N * width_;
+  }
+  // real part of the spatial domain output (N x N) of a channel is at
+  // outputReal(channel)[i * outputStride()], valid after execute()
+  const float *outputReal(int channel = 0) const {
+    return outReal_ + channel * N * N * outputStride();
+  }
+  int outputStride() const { return mode_ == FFT_COMPLEX ? 2 : 1; }
+
+  void execute();
+
+  // The transform of execute() as two passes that can be split into tasks:
+  // executeColumns(begin, end) transforms spectrum columns [begin, end) of
+  // every channel in place; once all columns are done, executeRows(begin,
+  // end) transforms rows [begin, end) into the output. Different ranges may
+  // run on different threads at the same time.
+  void executeColumns(int begin, int end);
+  void executeRows(int begin, int end);
+
+  // Backend of the OceanFFTs created afterwards, FFTW by default
+  static void setBackend(FFTBackend backend);
+
+  static void initThreads();
+  static void loadWisdom();
+  static void saveWisdom();
+
+ private:
+  int N;
+  int channels_;
+  FFTMode mode_;
+  FFTBackend backend_;
+  int threads_;
+  int width_;
+  fftwf_complex *in_;
+  float *outReal_;  // fftwf_complex * in FFT_COMPLEX mode
+  fftwf_plan plan_;
+  // plans of the split passes for SPLIT_FFT_BLOCK lines and for one line
+  fftwf_plan columnPlans_[2];
+  fftwf_plan rowPlans_[2];
+  const StockhamPasses *stockham_ = nullptr;
+
+  void planSplitPasses(unsigned planFlags);
+
+  OceanFFT(const OceanFFT &) = delete;
+  OceanFFT &operator=(const OceanFFT &) = delete;
+};
+
+// Times FFTW against the Stockham FFT on an n x n half spectrum with the
+// channels of a Wave, single threaded, and prints the largest difference
+void benchmarkFFTBackends(int n, int channels);
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef OFFLINE_OCEAN_H
+#define OFFLINE_OCEAN_H
+
+#include <cstddef>
+
+#include "dispersion.h"
+#include "spectrumModels.h"
+
+// Offline height fields of film resolution (8192^2 and beyond), where h0,
+// the evolved spectrum and the result do not fit in memory next to the rest
+// of the application. Everything lives in files that are only mapped a
+// window at a time:
+//   1. h0 is generated in row bands into spectrumPath, a spectrum snapshot
+//      that later renders of the same ocean reuse
+//   2. the spectrum at `time` is evolved row by row into an N x (N/2 + 1)
+//      scratch file in FFTW's half spectrum order
+//   3. the column transforms run on slabs of columns gathered from the
+//      scratch file, transformed and scattered back
+//   4. the row transforms (complex to real) write the output file a band of
+//      rows at a time, so it fills progressively
+// Mapped windows and buffers of every pass stay within memoryBudget,
+// whatever N.
+struct OfflineHeightFieldParams {
+  int n = 8192;  // power of two
+  float patchSize = 1000.0f;
+  float gravity = 9.81f;
+  unsigned seed = 1;
+  SpectrumParams spectrum;
+  DispersionParams dispersion;
+  float time = 0.0f;  // seconds
+  size_t memoryBudget = size_t(256) << 20;
+
+  const char *spectrumPath = "spectrum_offline.ocean";
+  const char *scratchPath = "spectrum_offline.scratch";
+  // heights in metres as a single channel PFM, rows bottom to top
+  const char *outputPath = "heightfield.pfm";
+};
+
+// Same heights as the height channel of a Wave with the same parameters;
+// false if a file cannot be created or mapped
+bool renderOfflineHeightField(const OfflineHeightFieldParams &params);
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef PHILOX_H
+#define PHILOX_H
+
+#include <cmath>
+#include <cstdint>
+
+// Philox4x32-10 counter-based generator (Salmon et al., "Parallel random
+// numbers: as easy as 1, 2, 3"). The output is a pure function of
+// (counter, key), so any bin can be drawn independently of the others and
+// the result does not depend on how the work is split across threads.
+struct Philox4x32 {
+  uint32_t v[4];
+};
+
+inline Philox4x32 philox4x32(Philox4x32 counter, uint32_t key0,
+                             uint32_t key1) {
+  const uint32_t M0 = 0xD2511F53u, M1 = 0xCD9E8D57u;
+  const uint32_t W0 = 0x9E3779B9u, W1 = 0xBB67AE85u;
+
+  for (int round = 0; round < 10; ++round) {
+    uint64_t p0 = uint64_t(M0) * counter.v[0];
+    uint64_t p1 = uint64_t(M1) * counter.v[2];
+    counter = {{uint32_t(p1 >> 32) ^ counter.v[1] ^ key0, uint32_t(p1),
+                uint32_t(p0 >> 32) ^ counter.v[3] ^ key1, uint32_t(p0)}};
+    key0 += W0;
+    key1 += W1;
+  }
+  return counter;
+}
+
+// uniform in (0, 1), never 0 so it is safe to take the log of
+inline float philoxUniform(uint32_t x) {
+  return float(x >> 8) * (1.0f / 16777216.0f) + (0.5f / 16777216.0f);
+}
+
+// Two independent standard normal draws for element `index` of stream
+// `seed` (Box-Muller on the first two words of the block)
+inline void philoxGaussian2(uint32_t seed, uint64_t index, float *a,
+                            float *b) {
+  Philox4x32 r = philox4x32(
+      {{uint32_t(index), uint32_t(index >> 32), 0u, 0u}}, seed, 0u);
+  float radius = std::sqrt(-2.0f * std::log(philoxUniform(r.v[0])));
+  float angle = 6.28318530717958647692f * philoxUniform(r.v[1]);
+  *a = radius * std::cos(angle);
+  *b = radius * std::sin(angle);
+}
+
+#endif
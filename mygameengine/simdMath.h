@@ -0,0 +1,123 @@
+#ifndef SIMD_MATH_H
+#define SIMD_MATH_H
+
+// Vectorized math for the SIMD kernels. Only include from translation units
+// compiled for the matching instruction set (/arch:AVX2, /arch:AVX512), after
+// defining SIMD_MATH_AVX2 and/or SIMD_MATH_AVX512 to pick the sections.
+
+#include <immintrin.h>
+
+// Cephes style sincos: range reduction by pi/4 in three parts, then a
+// minimax polynomial on [-pi/4, pi/4]. A few ulp of error while |x| stays
+// below ~8192, larger arguments lose precision in the range reduction.
+#define SIMD_SINCOS_FOPI 1.27323954473516f  // 4 / pi
+#define SIMD_SINCOS_DP1 -0.78515625f
+#define SIMD_SINCOS_DP2 -2.4187564849853515625e-4f
+#define SIMD_SINCOS_DP3 -3.77489497744594108e-8f
+#define SIMD_SINCOS_COS_C0 2.443315711809948e-5f
+#define SIMD_SINCOS_COS_C1 -1.388731625493765e-3f
+#define SIMD_SINCOS_COS_C2 4.166664568298827e-2f
+#define SIMD_SINCOS_SIN_C0 -1.9515295891e-4f
+#define SIMD_SINCOS_SIN_C1 8.3321608736e-3f
+#define SIMD_SINCOS_SIN_C2 -1.6666654611e-1f
+
+#ifdef SIMD_MATH_AVX2
+static inline void sincos256(__m256 x, __m256 *s, __m256 *c) {
+  const __m256 signMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x80000000));
+
+  __m256 signSin = _mm256_and_ps(x, signMask);
+  x = _mm256_andnot_ps(signMask, x);
+
+  // octant j, rounded up to even
+  __m256i j = _mm256_cvttps_epi32(
+      _mm256_mul_ps(x, _mm256_set1_ps(SIMD_SINCOS_FOPI)));
+  j = _mm256_add_epi32(j, _mm256_set1_epi32(1));
+  j = _mm256_and_si256(j, _mm256_set1_epi32(~1));
+  __m256 y = _mm256_cvtepi32_ps(j);
+
+  __m256 swapSin = _mm256_castsi256_ps(
+      _mm256_slli_epi32(_mm256_and_si256(j, _mm256_set1_epi32(4)), 29));
+  __m256 signCos = _mm256_castsi256_ps(_mm256_slli_epi32(
+      _mm256_andnot_si256(_mm256_sub_epi32(j, _mm256_set1_epi32(2)),
+                          _mm256_set1_epi32(4)),
+      29));
+  // lanes where the sine polynomial gives sin (and the cosine one cos)
+  __m256 polyMask = _mm256_castsi256_ps(_mm256_cmpeq_epi32(
+      _mm256_and_si256(j, _mm256_set1_epi32(2)), _mm256_setzero_si256()));
+  signSin = _mm256_xor_ps(signSin, swapSin);
+
+  x = _mm256_fmadd_ps(y, _mm256_set1_ps(SIMD_SINCOS_DP1), x);
+  x = _mm256_fmadd_ps(y, _mm256_set1_ps(SIMD_SINCOS_DP2), x);
+  x = _mm256_fmadd_ps(y, _mm256_set1_ps(SIMD_SINCOS_DP3), x);
+  __m256 z = _mm256_mul_ps(x, x);
+
+  __m256 yc = _mm256_set1_ps(SIMD_SINCOS_COS_C0);
+  yc = _mm256_fmadd_ps(yc, z, _mm256_set1_ps(SIMD_SINCOS_COS_C1));
+  yc = _mm256_fmadd_ps(yc, z, _mm256_set1_ps(SIMD_SINCOS_COS_C2));
+  yc = _mm256_mul_ps(_mm256_mul_ps(yc, z), z);
+  yc = _mm256_fnmadd_ps(z, _mm256_set1_ps(0.5f), yc);
+  yc = _mm256_add_ps(yc, _mm256_set1_ps(1.0f));
+
+  __m256 ys = _mm256_set1_ps(SIMD_SINCOS_SIN_C0);
+  ys = _mm256_fmadd_ps(ys, z, _mm256_set1_ps(SIMD_SINCOS_SIN_C1));
+  ys = _mm256_fmadd_ps(ys, z, _mm256_set1_ps(SIMD_SINCOS_SIN_C2));
+  ys = _mm256_fmadd_ps(_mm256_mul_ps(ys, z), x, x);
+
+  __m256 sinv = _mm256_blendv_ps(yc, ys, polyMask);
+  __m256 cosv = _mm256_blendv_ps(ys, yc, polyMask);
+  *s = _mm256_xor_ps(sinv, signSin);
+  *c = _mm256_xor_ps(cosv, signCos);
+}
+#endif
+
+#ifdef SIMD_MATH_AVX512
+static inline void sincos512(__m512 x, __m512 *s, __m512 *c) {
+  const __m512i signMask = _mm512_set1_epi32(0x80000000);
+
+  __m512i signSin = _mm512_and_si512(_mm512_castps_si512(x), signMask);
+  x = _mm512_abs_ps(x);
+
+  // octant j, rounded up to even
+  __m512i j = _mm512_cvttps_epi32(
+      _mm512_mul_ps(x, _mm512_set1_ps(SIMD_SINCOS_FOPI)));
+  j = _mm512_add_epi32(j, _mm512_set1_epi32(1));
+  j = _mm512_and_si512(j, _mm512_set1_epi32(~1));
+  __m512 y = _mm512_cvtepi32_ps(j);
+
+  __m512i swapSin =
+      _mm512_slli_epi32(_mm512_and_si512(j, _mm512_set1_epi32(4)), 29);
+  __m512i signCos = _mm512_slli_epi32(
+      _mm512_andnot_si512(_mm512_sub_epi32(j, _mm512_set1_epi32(2)),
+                          _mm512_set1_epi32(4)),
+      29);
+  // lanes where the sine polynomial gives sin (and the cosine one cos)
+  __mmask16 polyMask = _mm512_testn_epi32_mask(j, _mm512_set1_epi32(2));
+  signSin = _mm512_xor_si512(signSin, swapSin);
+
+  x = _mm512_fmadd_ps(y, _mm512_set1_ps(SIMD_SINCOS_DP1), x);
+  x = _mm512_fmadd_ps(y, _mm512_set1_ps(SIMD_SINCOS_DP2), x);
+  x = _mm512_fmadd_ps(y, _mm512_set1_ps(SIMD_SINCOS_DP3), x);
+  __m512 z = _mm512_mul_ps(x, x);
+
+  __m512 yc = _mm512_set1_ps(SIMD_SINCOS_COS_C0);
+  yc = _mm512_fmadd_ps(yc, z, _mm512_set1_ps(SIMD_SINCOS_COS_C1));
+  yc = _mm512_fmadd_ps(yc, z, _mm512_set1_ps(SIMD_SINCOS_COS_C2));
+  yc = _mm512_mul_ps(_mm512_mul_ps(yc, z), z);
+  yc = _mm512_fnmadd_ps(z, _mm512_set1_ps(0.5f), yc);
+  yc = _mm512_add_ps(yc, _mm512_set1_ps(1.0f));
+
+  __m512 ys = _mm512_set1_ps(SIMD_SINCOS_SIN_C0);
+  ys = _mm512_fmadd_ps(ys, z, _mm512_set1_ps(SIMD_SINCOS_SIN_C1));
+  ys = _mm512_fmadd_ps(ys, z, _mm512_set1_ps(SIMD_SINCOS_SIN_C2));
+  ys = _mm512_fmadd_ps(_mm512_mul_ps(ys, z), x, x);
+
+  __m512 sinv = _mm512_mask_blend_ps(polyMask, yc, ys);
+  __m512 cosv = _mm512_mask_blend_ps(polyMask, ys, yc);
+  *s = _mm512_castsi512_ps(
+      _mm512_xor_si512(_mm512_castps_si512(sinv), signSin));
+  *c = _mm512_castsi512_ps(
+      _mm512_xor_si512(_mm512_castps_si512(cosv), signCos));
+}
+#endif
+
+#endif
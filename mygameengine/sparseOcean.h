@@ -0,0 +1,94 @@
+#ifndef SPARSE_OCEAN_H
+#define SPARSE_OCEAN_H
+
+#include <complex>
+#include <glm/glm.hpp>
+#include <span>
+#include <vector>
+
+#include "dispersion.h"
+
+// Heights at a few points and arbitrary times without running the FFT
+// (ship motion on its own tick, probes). The heights of the full inverse
+// transform are
+//   h(x, t) = 2 / N^2 sum_K Re(h0(K) e^(i (K.x + w(k) t)))
+// over all N^2 bins; this keeps the `bins` bins with the largest |h0(K)|,
+// which for real spectra hold nearly all of the energy, and sums them
+// directly. A query costs `bins` sincos and touches no frame state.
+//
+// Every dropped bin moves the height by at most its amplitude, so their sum
+// bounds the difference to the full FFT (errorBound()). With the random
+// phases of h0 the typical difference is much smaller, rmsError().
+
+// Bins of one evaluation, in planes of SPARSE_OCEAN_LANES padded length;
+// padding bins have zero amplitude
+struct SparseOceanBins {
+  const float *kx, *kz;  // wave vector, rad/m
+  const float *phase;    // w(k) t, reduced to [0, 2 pi)
+  const float *re, *im;  // 2 h0(K) / N^2, times the output height scale
+  int count;
+};
+
+const int SPARSE_OCEAN_LANES = 8;
+
+// sum_i re[i] cos(theta) - im[i] sin(theta), theta = kx x + kz z + phase
+typedef float (*SumSparseBinsFn)(const SparseOceanBins &bins, float x,
+                                 float z);
+
+float sumSparseBinsScalar(const SparseOceanBins &bins, float x, float z);
+// 8 bins per iteration, needs AVX2 + FMA
+float sumSparseBinsAVX2(const SparseOceanBins &bins, float x, float z);
+
+// Widest kernel the CPU supports
+SumSparseBinsFn selectSumSparseBinsKernel();
+
+struct SparseOceanParams {
+  int bins = 256;
+  float gravity = 9.81f;
+  DispersionParams dispersion;
+  float loopPeriod = 0.0f;  // as Wave::setLoopPeriod
+  // query positions p map to patch metres p * metresPerUnit + originMetres,
+  // heights are returned times heightScale
+  float metresPerUnit = 1.0f;
+  float originMetres = 0.0f;
+  float heightScale = 1.0f;
+};
+
+class SparseOcean {
+ public:
+  // From the centered n x n h0 of an L sized patch (see SpectrumGrid)
+  SparseOcean(const std::complex<float> *h0, int n, float patchSize,
+              const SparseOceanParams &params);
+
+  // Height at position (x, z) at time t; any thread
+  float evaluate(glm::vec2 position, double t) const;
+  // Heights of several positions at time t, for as many as both spans hold
+  void evaluate(std::span<const glm::vec2> positions, double t,
+                std::span<float> heights) const;
+
+  int bins() const { return bins_; }
+  // Largest difference to the full FFT's heights (plus float rounding)
+  float errorBound() const { return errorBound_; }
+  // Expected rms difference to the full FFT's heights
+  float rmsError() const { return rmsError_; }
+  // Share of the spectrum's energy in the kept bins
+  float energyFraction() const { return energyFraction_; }
+
+ private:
+  int bins_ = 0;
+  int padded_ = 0;  // bins_ rounded up to SPARSE_OCEAN_LANES
+  float patchSize_;
+  float metresPerUnit_, originMetres_;
+  // kx, kz, re, im planes of padded_ bins each
+  std::vector<float> planes_;
+  std::vector<float> omega_;
+  float errorBound_ = 0.0f;
+  float rmsError_ = 0.0f;
+  float energyFraction_ = 1.0f;
+  SumSparseBinsFn sumBins_;
+
+  void phases(double t, float *phase) const;
+  float height(const float *phase, glm::vec2 position) const;
+};
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef SPECTRUM_KERNELS_H
+#define SPECTRUM_KERNELS_H
+
+#include <complex>
+
+// A run of bins of the paired spectrum: h0(K) and conj(h0(-K)) of the same
+// bin side by side, each as separate real and imaginary planes. Built once
+// per spectrum in the FFT's bin order, so the evolution streams forward
+// through all four planes and never gathers the mirrored bin.
+struct PairedSpectrumRun {
+  const float *re;        // Re h0(K)
+  const float *im;        // Im h0(K)
+  const float *mirrorRe;  // Re conj(h0(-K))
+  const float *mirrorIm;  // Im conj(h0(-K))
+};
+
+// Time evolution of one contiguous run of spectrum bins:
+//   out[i] = h0(K) e^(i w[i] t) + conj(h0(-K)) e^(-i w[i] t)
+// w holds the precomputed dispersion w(k) of each bin.
+typedef void (*EvolveSpectrumFn)(const PairedSpectrumRun &h0, const float *w,
+                                 int count, float t,
+                                 std::complex<float> *out);
+
+void evolveSpectrumScalar(const PairedSpectrumRun &h0, const float *w,
+                          int count, float t, std::complex<float> *out);
+// 8 bins per iteration, needs AVX2 + FMA
+void evolveSpectrumAVX2(const PairedSpectrumRun &h0, const float *w,
+                        int count, float t, std::complex<float> *out);
+// 16 bins per iteration, needs AVX-512F
+void evolveSpectrumAVX512(const PairedSpectrumRun &h0, const float *w,
+                          int count, float t, std::complex<float> *out);
+
+// Fixed time step variant without transcendentals: the phase planes hold
+// e^(i w[i] t) and are advanced by the rotor planes e^(i w[i] dt) before use.
+//   phase[i] *= rotor[i]
+//   out[i] = h0(K) phase[i] + conj(h0(-K)) conj(phase[i])
+typedef void (*EvolveSpectrumRotorFn)(const PairedSpectrumRun &h0,
+                                      const float *rotorRe,
+                                      const float *rotorIm, float *phaseRe,
+                                      float *phaseIm, int count,
+                                      std::complex<float> *out);
+
+void evolveSpectrumRotorScalar(const PairedSpectrumRun &h0,
+                               const float *rotorRe, const float *rotorIm,
+                               float *phaseRe, float *phaseIm, int count,
+                               std::complex<float> *out);
+void evolveSpectrumRotorAVX2(const PairedSpectrumRun &h0,
+                             const float *rotorRe, const float *rotorIm,
+                             float *phaseRe, float *phaseIm, int count,
+                             std::complex<float> *out);
+void evolveSpectrumRotorAVX512(const PairedSpectrumRun &h0,
+                               const float *rotorRe, const float *rotorIm,
+                               float *phaseRe, float *phaseIm, int count,
+                               std::complex<float> *out);
+
+// Pulls the phases back onto the unit circle; repeated multiplication lets
+// their magnitude drift by about one float ulp per step
+void renormalizePhases(float *phaseRe, float *phaseIm, int count);
+
+// Widest kernels the CPU supports
+EvolveSpectrumFn selectEvolveSpectrumKernel();
+EvolveSpectrumRotorFn selectEvolveSpectrumRotorKernel();
+
+#endif
@@ -0,0 +1,163 @@
+#ifndef SPECTRUM_MODELS_H
+#define SPECTRUM_MODELS_H
+
+#include <cmath>
+#include <complex>
+
+// Directional wave spectra the initial heights h0(k) are drawn from
+enum SpectrumModel {
+  SPECTRUM_PHILLIPS,           // Tessendorf's Phillips spectrum
+  SPECTRUM_PIERSON_MOSKOWITZ,  // fully developed sea
+  SPECTRUM_JONSWAP,            // fetch limited sea with a sharper peak
+  SPECTRUM_TMA,                // JONSWAP attenuated for finite depth
+  SPECTRUM_MODEL_COUNT,
+};
+
+struct SpectrumParams {
+  SpectrumModel model = SPECTRUM_PHILLIPS;
+  float amplitude = 4.0f;  // A, Phillips only
+  float windSpeed = 10.0f;  // m/s, at 10 m (19.5 m for Pierson-Moskowitz)
+  float windDirection = 0.785398163f;  // radians from +x, pi/4 = (1, 1)
+  float fetch = 100000.0f;   // m, JONSWAP and TMA
+  float peakEnhancement = 3.3f;  // gamma, JONSWAP and TMA
+  float depth = 100.0f;      // m, TMA
+  float spreading = 8.0f;    // s in cos^2s(theta / 2), all but Phillips
+  // only |K| in [minWavenumber, maxWavenumber) is kept, rad/m
+  float minWavenumber = 0.0f;
+  float maxWavenumber = INFINITY;
+};
+
+// Everything the per-bin evaluation needs, derived once per grid
+struct SpectrumConstants {
+  float g;
+  float windX, windY;  // unit wind direction
+  float binArea;       // dk^2 = (2 pi / L)^2
+
+  // Phillips
+  float amplitude;
+  float largestWave2;  // (V^2 / g)^2
+
+  // Pierson-Moskowitz, JONSWAP, TMA: S(w) = alpha g^2 / w^5 e^(-5/4 (wp/w)^4)
+  float alpha;
+  float peakOmega;
+  float logGamma;
+  float depthFactor;  // sqrt(depth / g), TMA
+  float spreading;
+  float spreadingNorm;  // makes the spreading function integrate to 1
+};
+
+SpectrumConstants makeSpectrumConstants(const SpectrumParams &params, float g,
+                                        float patchSize);
+
+// Evaluates P(K) for one row of wave vectors (kx[i], ky), with the gaussian
+// draws then scaled by sqrt(P / 2). Models are policies with an inline
+// evaluate(), so the row loop is specialized per model at compile time and
+// has no calls other than exp / log / sqrt, which compilers vectorize.
+typedef void (*SpectrumRowFn)(const SpectrumConstants &c, const float *kx,
+                              float ky, int count, float *out);
+
+struct PhillipsSpectrum {
+  static inline float evaluate(const SpectrumConstants &c, float kx, float ky,
+                               float k2) {
+    // |k.w|^8 / k^8 without normalizing K
+    float kw = kx * c.windX + ky * c.windY;
+    float cos2 = kw * kw / k2;
+    float cos8 = (cos2 * cos2) * (cos2 * cos2);
+    float p = c.amplitude * std::exp(-1.0f / (k2 * c.largestWave2)) /
+              (k2 * k2) * cos8;
+    return k2 < 1e-8f ? 0.0f : p;
+  }
+};
+
+// S(k, theta) = S(w) dw/dk / k D(theta) for deep water w = sqrt(g k), with
+// the spreading D = N(s) cos^2s(theta / 2); Frequency supplies S(w)
+template <class Frequency>
+struct DirectionalSpectrum {
+  static inline float evaluate(const SpectrumConstants &c, float kx, float ky,
+                               float k2) {
+    float k = std::sqrt(k2);
+    float omega = std::sqrt(c.g * k);
+    float dOmegaDk = 0.5f * c.g / omega;
+
+    // cos^2(theta / 2) = (1 + cos theta) / 2
+    float cosTheta = (kx * c.windX + ky * c.windY) / k;
+    float halfAngle = 0.5f + 0.5f * cosTheta;
+    float spreading =
+        c.spreadingNorm * std::exp(c.spreading * std::log(halfAngle + 1e-30f));
+
+    float s = Frequency::evaluate(c, omega) * dOmegaDk / k * spreading;
+    // P = 2 S dk^2, so sqrt(P / 2) is the rms amplitude of the bin
+    float p = 2.0f * s * c.binArea;
+    return k2 < 1e-8f ? 0.0f : p;
+  }
+};
+
+struct PiersonMoskowitzFrequency {
+  static inline float evaluate(const SpectrumConstants &c, float omega) {
+    float ratio = c.peakOmega / omega;
+    float ratio4 = (ratio * ratio) * (ratio * ratio);
+    float omega5 = (omega * omega) * (omega * omega) * omega;
+    return c.alpha * c.g * c.g / omega5 * std::exp(-1.25f * ratio4);
+  }
+};
+
+struct JonswapFrequency {
+  static inline float evaluate(const SpectrumConstants &c, float omega) {
+    float sigma = omega <= c.peakOmega ? 0.07f : 0.09f;
+    float d = (omega - c.peakOmega) / (sigma * c.peakOmega);
+    float r = std::exp(-0.5f * d * d);
+    // gamma^r
+    return PiersonMoskowitzFrequency::evaluate(c, omega) *
+           std::exp(r * c.logGamma);
+  }
+};
+
+struct TmaFrequency {
+  static inline float evaluate(const SpectrumConstants &c, float omega) {
+    // Kitaigorodskii depth attenuation
+    float omegaH = omega * c.depthFactor;
+    float phi = omegaH <= 1.0f   ? 0.5f * omegaH * omegaH
+                : omegaH < 2.0f ? 1.0f - 0.5f * (2.0f - omegaH) * (2.0f - omegaH)
+                                 : 1.0f;
+    return JonswapFrequency::evaluate(c, omega) * phi;
+  }
+};
+
+typedef DirectionalSpectrum<PiersonMoskowitzFrequency> PiersonMoskowitzSpectrum;
+typedef DirectionalSpectrum<JonswapFrequency> JonswapSpectrum;
+typedef DirectionalSpectrum<TmaFrequency> TmaSpectrum;
+
+template <class Model>
+void evaluateSpectrumRow(const SpectrumConstants &c, const float *kx, float ky,
+                         int count, float *out) {
+  const float ky2 = ky * ky;
+  for (int i = 0; i < count; ++i) {
+    out[i] = Model::evaluate(c, kx[i], ky, kx[i] * kx[i] + ky2);
+  }
+}
+
+// Row evaluator of a model picked at runtime
+SpectrumRowFn spectrumRowKernel(SpectrumModel model);
+const char *spectrumModelName(SpectrumModel model);
+
+// Centered n x n grid of h0(K) over an L sized patch: row i, column j hold
+// K = 2 pi (j - n/2, i - n/2) / L
+struct SpectrumGrid {
+  int n;
+  float patchSize;
+  float gravity;
+  unsigned seed;
+  SpectrumParams params;
+};
+
+// Rows [rowBegin, rowEnd) of the grid's h0, n values per row. Every bin
+// draws its gaussians from a counter-based generator keyed by (seed, bin
+// index), so rows generated on any thread, or in separate passes for grids
+// larger than memory, are bit-identical.
+void generateSpectrumRows(const SpectrumGrid &grid, int rowBegin, int rowEnd,
+                          std::complex<float> *out);
+
+// Times the bulk evaluation of every model over an n x n grid and prints it
+void benchmarkSpectrumModels(int n, float patchSize);
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef SPECTRUM_SNAPSHOT_H
+#define SPECTRUM_SNAPSHOT_H
+
+#include <complex>
+#include <cstdint>
+
+#include "mappedFile.h"
+#include "spectrumModels.h"
+
+// File the initial spectrum is cached in (relative to the working directory,
+// like the FFTW wisdom)
+#define SPECTRUM_SNAPSHOT_FILE "spectrum.ocean"
+#define SPECTRUM_SNAPSHOT_MAGIC "OCSP"
+// bump whenever the generation of h0 changes for the same parameters
+#define SPECTRUM_SNAPSHOT_VERSION 4
+
+// Everything h0(k) depends on. A snapshot is only used when all of it
+// matches, otherwise the spectrum is regenerated and the file rewritten.
+struct SpectrumSnapshotHeader {
+  char magic[4];
+  uint32_t version;
+  int32_t n;  // h0 is n x n complex values, centered, after the header
+  float patchSize;
+  float gravity;
+  uint32_t seed;
+  // SpectrumParams
+  int32_t model;
+  float amplitude;
+  float windSpeed;
+  float windDirection;
+  float fetch;
+  float peakEnhancement;
+  float depth;
+  float spreading;
+  float minWavenumber;
+  float maxWavenumber;
+};
+
+// Header of a snapshot of the grid's h0 (magic and version are filled in
+// when it is written)
+SpectrumSnapshotHeader makeSpectrumSnapshotHeader(const SpectrumGrid &grid);
+
+// Memory-mapped h0(k). Loading costs a page fault per touched page instead
+// of N^2 random draws and Phillips evaluations.
+class SpectrumSnapshot {
+ public:
+  static bool write(const char *path, const SpectrumSnapshotHeader &header,
+                    const std::complex<float> *h0);
+  // Whether a file of fileSize bytes starting with `stored` is a snapshot
+  // made with the parameters of `expected`
+  static bool isValid(const SpectrumSnapshotHeader &stored,
+                      const SpectrumSnapshotHeader &expected,
+                      size_t fileSize);
+
+  // false if the file is missing, corrupt or was made for other parameters;
+  // only magic, version and the parameters of `expected` are compared
+  bool open(const char *path, const SpectrumSnapshotHeader &expected);
+  void close() { file.close(); }
+
+  // valid while the snapshot is open
+  const std::complex<float> *h0() const {
+    return reinterpret_cast<const std::complex<float> *>(
+        static_cast<const SpectrumSnapshotHeader *>(file.data()) + 1);
+  }
+
+ private:
+  MappedFile file;
+};
+
+#endif
@@ -0,0 +1,58 @@
+#include "cpuFeatures.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+#include <cstdint>
+
+static void cpuid(int leaf, int subleaf, unsigned regs[4]) {
+#ifdef _MSC_VER
+  __cpuidex(reinterpret_cast<int *>(regs), leaf, subleaf);
+#else
+  __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static uint64_t xgetbv0() {
+#ifdef _MSC_VER
+  return _xgetbv(0);
+#else
+  unsigned lo, hi;
+  __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+  return (uint64_t(hi) << 32) | lo;
+#endif
+}
+
+static CpuFeatures detect() {
+  CpuFeatures features;
+  unsigned regs[4];
+
+  cpuid(0, 0, regs);
+  if (regs[0] < 7) return features;
+
+  cpuid(1, 0, regs);
+  bool osxsave = regs[2] & (1u << 27);
+  bool fma = regs[2] & (1u << 12);
+  bool f16c = regs[2] & (1u << 29);
+  if (!osxsave) return features;
+
+  // the OS has to save the YMM (and ZMM) registers on context switches
+  uint64_t xcr0 = xgetbv0();
+  bool ymmState = (xcr0 & 0x6) == 0x6;
+  bool zmmState = (xcr0 & 0xe6) == 0xe6;
+
+  features.f16c = ymmState && f16c;
+
+  cpuid(7, 0, regs);
+  features.avx2 = ymmState && fma && (regs[1] & (1u << 5));
+  features.avx512 = features.avx2 && zmmState && (regs[1] & (1u << 16));
+  return features;
+}
+
+const CpuFeatures &cpuFeatures() {
+  static const CpuFeatures features = detect();
+  return features;
+}
@@ -0,0 +1,23 @@
+#include "dispersion.h"
+
+#include <cmath>
+
+float dispersionOmega(const DispersionParams &params, float g, float k) {
+  switch (params.model) {
+    case DISPERSION_FINITE_DEPTH:
+      return std::sqrt(g * k * std::tanh(k * params.depth));
+    case DISPERSION_CAPILLARY_GRAVITY:
+      return std::sqrt(
+          (g * k + params.surfaceTension / params.density * k * k * k) *
+          std::tanh(k * params.depth));
+    case DISPERSION_DEEP_WATER:
+    default:
+      return std::sqrt(g * k);
+  }
+}
+
+float loopOmega(float omega, float loopPeriod) {
+  if (loopPeriod <= 0.0f) return omega;
+  float w0 = 6.28318530718f / loopPeriod;
+  return std::floor(omega / w0) * w0;
+}
@@ -0,0 +1,47 @@
+#include "fieldKernels.h"
+
+#include "cpuFeatures.h"
+
+void packFieldsRange(const PackFieldsRow &row, int begin, int end) {
+  const int n = row.n;
+  const int s = row.stride;
+
+  for (int x = begin; x < end; ++x) {
+    int left = (x == 0 ? n - 1 : x - 1) * s;
+    int right = (x == n - 1 ? 0 : x + 1) * s;
+    int i = x * s;
+    float scale = row.scale[x & 1];
+    // every neighbour sits on the other colour of the checkerboard
+    float neighbourScale = row.scale[(x + 1) & 1] * row.jacobianScale;
+
+    float dx = row.displacementX[i] * scale;
+    float dz = row.displacementZ[i] * scale;
+
+    // derivatives of the rendered horizontal displacement
+    float dxdx = (row.displacementX[right] - row.displacementX[left]) *
+                 neighbourScale;
+    float dzdz = (row.displacementZDown[i] - row.displacementZUp[i]) *
+                 neighbourScale;
+    float dxdz = (row.displacementXDown[i] - row.displacementXUp[i]) *
+                 neighbourScale;
+    float dzdx = (row.displacementZ[right] - row.displacementZ[left]) *
+                 neighbourScale;
+    float jacobian = (1.0f + dxdx) * (1.0f + dzdz) - dxdz * dzdx;
+
+    row.displacement[x * 4 + 0] = dx;
+    row.displacement[x * 4 + 1] = row.height[i] * scale;
+    row.displacement[x * 4 + 2] = dz;
+    row.displacement[x * 4 + 3] = jacobian;
+    row.slope[x * 2 + 0] = row.slopeX[i] * scale;
+    row.slope[x * 2 + 1] = row.slopeZ[i] * scale;
+  }
+}
+
+void packFieldsScalar(const PackFieldsRow &row) {
+  packFieldsRange(row, 0, row.n);
+}
+
+PackFieldsFn selectPackFieldsKernel() {
+  if (cpuFeatures().avx2) return packFieldsAVX2;
+  return packFieldsScalar;
+}
@@ -0,0 +1,83 @@
+// Compiled with /arch:AVX2, only called when cpuFeatures() reports AVX2.
+#include "fieldKernels.h"
+
+#if defined(__GNUC__) && !defined(__AVX2__)
+#pragma GCC target("avx2,fma")
+#endif
+
+#include <immintrin.h>
+
+void packFieldsAVX2(const PackFieldsRow &row) {
+  const int n = row.n;
+  if (row.stride != 1 || n < 10) {
+    packFieldsScalar(row);
+    return;
+  }
+
+  // column 0 needs the wrapped left neighbour
+  packFieldsRange(row, 0, 1);
+
+  // per lane scales, the loop starts on an odd column and steps by 8
+  const __m256 scale =
+      _mm256_setr_ps(row.scale[1], row.scale[0], row.scale[1], row.scale[0],
+                     row.scale[1], row.scale[0], row.scale[1], row.scale[0]);
+  const __m256 jacobianScale = _mm256_set1_ps(row.jacobianScale);
+  const __m256 neighbourScale = _mm256_mul_ps(
+      _mm256_setr_ps(row.scale[0], row.scale[1], row.scale[0], row.scale[1],
+                     row.scale[0], row.scale[1], row.scale[0], row.scale[1]),
+      jacobianScale);
+  const __m256 one = _mm256_set1_ps(1.0f);
+
+  int x = 1;
+  for (; x + 8 <= n - 1; x += 8) {
+    __m256 dx = _mm256_mul_ps(_mm256_loadu_ps(row.displacementX + x), scale);
+    __m256 h = _mm256_mul_ps(_mm256_loadu_ps(row.height + x), scale);
+    __m256 dz = _mm256_mul_ps(_mm256_loadu_ps(row.displacementZ + x), scale);
+
+    __m256 dxdx = _mm256_mul_ps(
+        _mm256_sub_ps(_mm256_loadu_ps(row.displacementX + x + 1),
+                      _mm256_loadu_ps(row.displacementX + x - 1)),
+        neighbourScale);
+    __m256 dzdx = _mm256_mul_ps(
+        _mm256_sub_ps(_mm256_loadu_ps(row.displacementZ + x + 1),
+                      _mm256_loadu_ps(row.displacementZ + x - 1)),
+        neighbourScale);
+    __m256 dzdz = _mm256_mul_ps(
+        _mm256_sub_ps(_mm256_loadu_ps(row.displacementZDown + x),
+                      _mm256_loadu_ps(row.displacementZUp + x)),
+        neighbourScale);
+    __m256 dxdz = _mm256_mul_ps(
+        _mm256_sub_ps(_mm256_loadu_ps(row.displacementXDown + x),
+                      _mm256_loadu_ps(row.displacementXUp + x)),
+        neighbourScale);
+    __m256 jacobian =
+        _mm256_fnmadd_ps(dxdz, dzdx, _mm256_mul_ps(_mm256_add_ps(one, dxdx),
+                                                   _mm256_add_ps(one, dzdz)));
+
+    // 4 x 8 transpose into RGBA texels
+    __m256 t0 = _mm256_unpacklo_ps(dx, h);        // texels 0 1 | 4 5
+    __m256 t1 = _mm256_unpackhi_ps(dx, h);        // texels 2 3 | 6 7
+    __m256 t2 = _mm256_unpacklo_ps(dz, jacobian);
+    __m256 t3 = _mm256_unpackhi_ps(dz, jacobian);
+    __m256 u0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));  // 0 | 4
+    __m256 u1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));  // 1 | 5
+    __m256 u2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));  // 2 | 6
+    __m256 u3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));  // 3 | 7
+    float *d = row.displacement + x * 4;
+    _mm256_storeu_ps(d, _mm256_permute2f128_ps(u0, u1, 0x20));
+    _mm256_storeu_ps(d + 8, _mm256_permute2f128_ps(u2, u3, 0x20));
+    _mm256_storeu_ps(d + 16, _mm256_permute2f128_ps(u0, u1, 0x31));
+    _mm256_storeu_ps(d + 24, _mm256_permute2f128_ps(u2, u3, 0x31));
+
+    __m256 sx = _mm256_mul_ps(_mm256_loadu_ps(row.slopeX + x), scale);
+    __m256 sz = _mm256_mul_ps(_mm256_loadu_ps(row.slopeZ + x), scale);
+    __m256 lo = _mm256_unpacklo_ps(sx, sz);  // texels 0 1 | 4 5
+    __m256 hi = _mm256_unpackhi_ps(sx, sz);  // texels 2 3 | 6 7
+    _mm256_storeu_ps(row.slope + x * 2, _mm256_permute2f128_ps(lo, hi, 0x20));
+    _mm256_storeu_ps(row.slope + x * 2 + 8,
+                     _mm256_permute2f128_ps(lo, hi, 0x31));
+  }
+
+  // remaining columns, including the wrapping last one
+  packFieldsRange(row, x, n);
+}
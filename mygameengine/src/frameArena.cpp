@@ -0,0 +1,130 @@
+#include "frameArena.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+static atomic<unsigned long long> allocationCount{0};
+
+// Replacing the global operator new counts every allocation of the engine
+// and of the standard library; the array and nothrow forms call this one
+void *operator new(size_t bytes) {
+  allocationCount.fetch_add(1, memory_order_relaxed);
+  if (void *block = malloc(bytes ? bytes : 1)) return block;
+  throw bad_alloc();
+}
+
+void operator delete(void *block) noexcept { free(block); }
+
+void operator delete(void *block, size_t) noexcept { free(block); }
+
+unsigned long long heapAllocationCount() {
+  return allocationCount.load(memory_order_relaxed);
+}
+
+void *alignedAlloc(size_t bytes) {
+  allocationCount.fetch_add(1, memory_order_relaxed);
+  // aligned_alloc wants a multiple of the alignment
+  bytes = max<size_t>(bytes + ARENA_ALIGNMENT - 1, ARENA_ALIGNMENT) &
+          ~(ARENA_ALIGNMENT - 1);
+#ifdef _MSC_VER
+  void *block = _aligned_malloc(bytes, ARENA_ALIGNMENT);
+#else
+  void *block = aligned_alloc(ARENA_ALIGNMENT, bytes);
+#endif
+  if (!block) throw bad_alloc();
+  return block;
+}
+
+void alignedFree(void *block) {
+#ifdef _MSC_VER
+  _aligned_free(block);
+#else
+  free(block);
+#endif
+}
+
+static size_t alignUp(size_t bytes) {
+  return (bytes + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+}
+
+FrameArena::FrameArena(size_t initialBytes) {
+  if (initialBytes > 0) {
+    capacity_ = alignUp(initialBytes);
+    block_ = static_cast<char *>(alignedAlloc(capacity_));
+  }
+}
+
+FrameArena::~FrameArena() {
+  reset();
+  alignedFree(block_);
+}
+
+void *FrameArena::allocate(size_t bytes) {
+  bytes = alignUp(max<size_t>(bytes, 1));
+  if (used_ + bytes <= capacity_) {
+    void *p = block_ + used_;
+    used_ += bytes;
+    return p;
+  }
+  // out of room this frame; reset() folds this into the block
+  void *p = alignedAlloc(bytes);
+  overflow_.push_back(p);
+  overflowBytes_ += bytes;
+  return p;
+}
+
+void FrameArena::reset() {
+  if (!overflow_.empty()) {
+    for (void *p : overflow_) alignedFree(p);
+    // grow to what this frame needed, plus some headroom against frames
+    // that need slightly more
+    size_t needed = used_ + overflowBytes_;
+    alignedFree(block_);
+    capacity_ = alignUp(needed + needed / 4);
+    block_ = static_cast<char *>(alignedAlloc(capacity_));
+    overflow_.clear();
+    overflowBytes_ = 0;
+  }
+  used_ = 0;
+}
+
+PersistentPool::~PersistentPool() { trim(); }
+
+void *PersistentPool::allocate(size_t bytes) {
+  bytes = alignUp(max<size_t>(bytes, 1));
+  lock_guard<std::mutex> lock(mutex);
+  void *block;
+  auto found = released.find(bytes);
+  if (found != released.end()) {
+    block = found->second;
+    released.erase(found);
+  } else {
+    block = alignedAlloc(bytes);
+  }
+  live.emplace(block, bytes);
+  return block;
+}
+
+void PersistentPool::release(void *block) {
+  if (!block) return;
+  lock_guard<std::mutex> lock(mutex);
+  auto found = live.find(block);
+  if (found == live.end()) return;
+  released.emplace(found->second, block);
+  live.erase(found);
+}
+
+void PersistentPool::trim() {
+  lock_guard<std::mutex> lock(mutex);
+  for (auto &entry : released) alignedFree(entry.second);
+  released.clear();
+}
+
+PersistentPool &PersistentPool::shared() {
+  static PersistentPool pool;
+  return pool;
+}
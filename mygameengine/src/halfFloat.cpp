@@ -0,0 +1,74 @@
+#include "halfFloat.h"
+
+#include <cstring>
+
+#include "cpuFeatures.h"
+
+static inline uint32_t bitsOf(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+static inline float floatOf(uint32_t bits) {
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+uint16_t floatToHalf(float value) {
+  uint32_t x = bitsOf(value);
+  const uint32_t sign = x & 0x80000000u;
+  x ^= sign;
+
+  uint32_t half;
+  if (x >= 0x47800000u) {
+    // too large for fp16 (or already Inf / NaN)
+    half = x > 0x7f800000u ? 0x7e00u : 0x7c00u;
+  } else if (x < 0x38800000u) {
+    // subnormal or zero: adding 0.5 lines the 10 mantissa bits up at the
+    // bottom of the float, and the FPU does the rounding
+    half = bitsOf(floatOf(x) + floatOf(126u << 23)) - (126u << 23);
+  } else {
+    // rebias the exponent and round the 13 dropped bits to nearest even; a
+    // carry out of the mantissa correctly bumps the exponent (up to Inf)
+    const uint32_t odd = (x >> 13) & 1u;
+    x += ((15u - 127u) << 23) + 0xfffu + odd;
+    half = x >> 13;
+  }
+  return uint16_t((sign >> 16) | half);
+}
+
+float halfToFloat(uint16_t value) {
+  const uint32_t shiftedExponent = 0x7c00u << 13;
+  uint32_t x = uint32_t(value & 0x7fffu) << 13;
+  const uint32_t exponent = x & shiftedExponent;
+  x += (127u - 15u) << 23;
+  if (exponent == shiftedExponent) {
+    // Inf / NaN keep their all-ones exponent
+    x += (128u - 16u) << 23;
+  } else if (exponent == 0) {
+    // zero / subnormal: renormalize through the FPU
+    x += 1u << 23;
+    x = bitsOf(floatOf(x) - floatOf(113u << 23));
+  }
+  return floatOf(x | (uint32_t(value & 0x8000u) << 16));
+}
+
+void floatToHalfScalar(const float *in, int count, uint16_t *out) {
+  for (int i = 0; i < count; ++i) out[i] = floatToHalf(in[i]);
+}
+
+void halfToFloatScalar(const uint16_t *in, int count, float *out) {
+  for (int i = 0; i < count; ++i) out[i] = halfToFloat(in[i]);
+}
+
+FloatToHalfFn selectFloatToHalfKernel() {
+  if (cpuFeatures().f16c) return floatToHalfF16C;
+  return floatToHalfScalar;
+}
+
+HalfToFloatFn selectHalfToFloatKernel() {
+  if (cpuFeatures().f16c) return halfToFloatF16C;
+  return halfToFloatScalar;
+}
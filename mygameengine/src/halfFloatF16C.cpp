@@ -0,0 +1,27 @@
+// Compiled with /arch:AVX2, only called when cpuFeatures() reports F16C.
+#include "halfFloat.h"
+
+#if defined(__GNUC__) && !defined(__F16C__)
+#pragma GCC target("avx,f16c")
+#endif
+
+#include <immintrin.h>
+
+void floatToHalfF16C(const float *in, int count, uint16_t *out) {
+  int i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128i half = _mm256_cvtps_ph(_mm256_loadu_ps(in + i),
+                                   _MM_FROUND_TO_NEAREST_INT);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), half);
+  }
+  floatToHalfScalar(in + i, count - i, out + i);
+}
+
+void halfToFloatF16C(const uint16_t *in, int count, float *out) {
+  int i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128i half = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+    _mm256_storeu_ps(out + i, _mm256_cvtph_ps(half));
+  }
+  halfToFloatScalar(in + i, count - i, out + i);
+}
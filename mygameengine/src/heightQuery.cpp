@@ -0,0 +1,233 @@
+#include "heightQuery.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "cpuFeatures.h"
+#include "frameArena.h"
+#include "philox.h"
+
+using namespace std;
+
+static inline float texel(const HeightField &field, int x, int z) {
+  const int mask = field.n - 1;
+  return field.heights[((z & mask) << field.log2n) + (x & mask)];
+}
+
+// Catmull-Rom weights of the texels at -1, 0, 1 and 2 for a fraction t
+static inline void catmullRom(float t, float w[4]) {
+  float t2 = t * t, t3 = t2 * t;
+  w[0] = 0.5f * (-t3 + 2.0f * t2 - t);
+  w[1] = 0.5f * (3.0f * t3 - 5.0f * t2 + 2.0f);
+  w[2] = 0.5f * (-3.0f * t3 + 4.0f * t2 + t);
+  w[3] = 0.5f * (t3 - t2);
+}
+
+void sampleHeightsBilinearScalar(const HeightField &field,
+                                 const glm::vec2 *positions, int count,
+                                 float *out) {
+  for (int i = 0; i < count; ++i) {
+    float u = positions[i].x * field.texelsPerUnit + field.offset;
+    float v = positions[i].y * field.texelsPerUnit + field.offset;
+    float fu = floor(u), fv = floor(v);
+    int x = int(fu), z = int(fv);
+    float tx = u - fu, tz = v - fv;
+
+    float h00 = texel(field, x, z), h10 = texel(field, x + 1, z);
+    float h01 = texel(field, x, z + 1), h11 = texel(field, x + 1, z + 1);
+    float top = h00 + tx * (h10 - h00);
+    float bottom = h01 + tx * (h11 - h01);
+    out[i] = top + tz * (bottom - top);
+  }
+}
+
+void sampleHeightsBicubicScalar(const HeightField &field,
+                                const glm::vec2 *positions, int count,
+                                float *out) {
+  for (int i = 0; i < count; ++i) {
+    float u = positions[i].x * field.texelsPerUnit + field.offset;
+    float v = positions[i].y * field.texelsPerUnit + field.offset;
+    float fu = floor(u), fv = floor(v);
+    int x = int(fu), z = int(fv);
+    float wx[4], wz[4];
+    catmullRom(u - fu, wx);
+    catmullRom(v - fv, wz);
+
+    float sum = 0.0f;
+    for (int r = 0; r < 4; ++r) {
+      float row = 0.0f;
+      for (int c = 0; c < 4; ++c) {
+        row += wx[c] * texel(field, x - 1 + c, z - 1 + r);
+      }
+      sum += wz[r] * row;
+    }
+    out[i] = sum;
+  }
+}
+
+SampleHeightsFn selectSampleHeightsKernel(HeightFilter filter) {
+  const bool avx2 = cpuFeatures().avx2;
+  if (filter == HEIGHT_FILTER_BICUBIC) {
+    return avx2 ? sampleHeightsBicubicAVX2 : sampleHeightsBicubicScalar;
+  }
+  return avx2 ? sampleHeightsBilinearAVX2 : sampleHeightsBilinearScalar;
+}
+
+HeightSnapshot::HeightSnapshot(HeightSnapshot &&other) noexcept
+    : slot_(other.slot_) {
+  other.slot_ = nullptr;
+}
+
+HeightSnapshot &HeightSnapshot::operator=(HeightSnapshot &&other) noexcept {
+  if (this != &other) {
+    release();
+    slot_ = other.slot_;
+    other.slot_ = nullptr;
+  }
+  return *this;
+}
+
+void HeightSnapshot::release() {
+  if (slot_) slot_->readers.fetch_sub(1);
+  slot_ = nullptr;
+}
+
+bool HeightSnapshot::sample(span<const glm::vec2> positions,
+                            span<float> heights, HeightFilter filter) const {
+  if (!slot_) return false;
+  const int count = int(std::min(positions.size(), heights.size()));
+  selectSampleHeightsKernel(filter)(slot_->field, positions.data(), count,
+                                    heights.data());
+  return true;
+}
+
+void HeightFieldStore::resize(int size) {
+  clear();
+  n = size;
+  int log2n = 0;
+  while ((1 << log2n) < n) ++log2n;
+  for (HeightFieldSlot &slot : slots) {
+    slot.storage = PersistentPool::shared().allocate<float>(size_t(n) * n);
+    slot.field = HeightField();
+    slot.field.n = n;
+    slot.field.log2n = log2n;
+    slot.field.heights = slot.storage;
+  }
+}
+
+void HeightFieldStore::clear() {
+  current = -1;
+  writing = -1;
+  for (HeightFieldSlot &slot : slots) {
+    // readers that raced the reset back off on their own; held snapshots
+    // have to be released by their owners
+    while (slot.readers.load() != 0) this_thread::yield();
+    PersistentPool::shared().release(slot.storage);
+    slot.storage = nullptr;
+  }
+  n = 0;
+}
+
+float *HeightFieldStore::beginFrame() {
+  writing = -1;
+  if (n == 0) return nullptr;
+  const int latest = current.load();
+  for (int s = 0; s < SLOTS; ++s) {
+    // a reader can only pin a slot that is current, see acquire()
+    if (s != latest && slots[s].readers.load() == 0) {
+      writing = s;
+      return slots[s].storage;
+    }
+  }
+  return nullptr;
+}
+
+void HeightFieldStore::publish(float texelsPerUnit, float offset) {
+  if (writing < 0) return;
+  slots[writing].field.texelsPerUnit = texelsPerUnit;
+  slots[writing].field.offset = offset;
+  current = writing;
+  writing = -1;
+}
+
+HeightSnapshot HeightFieldStore::acquire() const {
+  HeightSnapshot snapshot;
+  for (;;) {
+    const int s = current.load();
+    if (s < 0) return snapshot;
+    // Pin, then check the slot is still current: once the count is up the
+    // writer skips the slot, and if it was replaced in between the writer
+    // may already be rewriting it
+    slots[s].readers.fetch_add(1);
+    if (current.load() == s) {
+      snapshot.slot_ = &slots[s];
+      return snapshot;
+    }
+    slots[s].readers.fetch_sub(1);
+  }
+}
+
+void benchmarkHeightQueries(int n) {
+  const int queries = 100000;
+  const int repeats = 20;
+
+  // a few waves over the patch; the values do not matter for the timing
+  vector<float> heights(size_t(n) * n);
+  for (int z = 0; z < n; ++z) {
+    for (int x = 0; x < n; ++x) {
+      float a = 6.2831853f * x / n, b = 6.2831853f * z / n;
+      heights[z * n + x] = sin(3.0f * a) * cos(2.0f * b) + 0.3f * sin(a + b);
+    }
+  }
+  HeightField field;
+  field.n = n;
+  while ((1 << field.log2n) < n) ++field.log2n;
+  field.heights = heights.data();
+  field.texelsPerUnit = float(n) / 1000.0f;
+  field.offset = 0.5f * n - 0.5f;
+
+  // scattered positions over twice the patch, so lookups wrap and miss
+  vector<glm::vec2> positions(queries);
+  for (int i = 0; i < queries; ++i) {
+    Philox4x32 r = philox4x32({{uint32_t(i), 0u, 0u, 0u}}, 7u, 0u);
+    positions[i] = glm::vec2(philoxUniform(r.v[0]) * 2000.0f - 1000.0f,
+                             philoxUniform(r.v[1]) * 2000.0f - 1000.0f);
+  }
+
+  struct Kernel {
+    const char *name;
+    SampleHeightsFn fn;
+  };
+  const Kernel kernels[2][2] = {
+      {{"bilinear scalar", sampleHeightsBilinearScalar},
+       {"bilinear AVX2", sampleHeightsBilinearAVX2}},
+      {{"bicubic scalar", sampleHeightsBicubicScalar},
+       {"bicubic AVX2", sampleHeightsBicubicAVX2}}};
+  const int variants = cpuFeatures().avx2 ? 2 : 1;
+
+  vector<float> reference(queries), out(queries);
+  for (const auto &filter : kernels) {
+    for (int k = 0; k < variants; ++k) {
+      double best = 1e30;
+      for (int r = 0; r < repeats; ++r) {
+        auto start = chrono::steady_clock::now();
+        filter[k].fn(field, positions.data(), queries, out.data());
+        best = std::min(best, chrono::duration<double>(
+                                  chrono::steady_clock::now() - start)
+                                  .count());
+      }
+      if (k == 0) reference = out;
+      float error = 0.0f;
+      for (int i = 0; i < queries; ++i) {
+        error = std::max(error, std::abs(out[i] - reference[i]));
+      }
+      cout << n << "x" << n << " height queries, " << filter[k].name << ": "
+           << queries << " in " << best * 1000.0 << " ms, largest difference "
+           << error << endl;
+    }
+  }
+}
@@ -0,0 +1,129 @@
+// Compiled with /arch:AVX2, only called when cpuFeatures() reports AVX2.
+#include "heightQuery.h"
+
+#if defined(__GNUC__) && !defined(__AVX2__)
+#pragma GCC target("avx2,fma")
+#endif
+
+#include <immintrin.h>
+
+// Texel coordinates of 8 positions: integer texel and fraction per axis
+struct TexelCoordinates {
+  __m256i x, z;
+  __m256 tx, tz;
+};
+
+static inline TexelCoordinates texelCoordinates(const HeightField &field,
+                                                const glm::vec2 *positions) {
+  const float *xz = reinterpret_cast<const float *>(positions);
+  __m256 a = _mm256_loadu_ps(xz), b = _mm256_loadu_ps(xz + 8);
+  // (x0 x1 x4 x5 | x2 x3 x6 x7), then the pairs back in order
+  __m256 x = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+  __m256 z = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+  x = _mm256_castpd_ps(
+      _mm256_permute4x64_pd(_mm256_castps_pd(x), _MM_SHUFFLE(3, 1, 2, 0)));
+  z = _mm256_castpd_ps(
+      _mm256_permute4x64_pd(_mm256_castps_pd(z), _MM_SHUFFLE(3, 1, 2, 0)));
+
+  const __m256 scale = _mm256_set1_ps(field.texelsPerUnit);
+  const __m256 offset = _mm256_set1_ps(field.offset);
+  __m256 u = _mm256_fmadd_ps(x, scale, offset);
+  __m256 v = _mm256_fmadd_ps(z, scale, offset);
+  __m256 fu = _mm256_floor_ps(u), fv = _mm256_floor_ps(v);
+
+  TexelCoordinates c;
+  c.x = _mm256_cvttps_epi32(fu);
+  c.z = _mm256_cvttps_epi32(fv);
+  c.tx = _mm256_sub_ps(u, fu);
+  c.tz = _mm256_sub_ps(v, fv);
+  return c;
+}
+
+// Wrapped column index, and wrapped row times n, of texel + delta
+static inline __m256i wrappedColumn(__m256i x, int delta, __m256i mask) {
+  return _mm256_and_si256(_mm256_add_epi32(x, _mm256_set1_epi32(delta)),
+                          mask);
+}
+
+static inline __m256i wrappedRow(__m256i z, int delta, __m256i mask,
+                                 __m128i log2n) {
+  return _mm256_sll_epi32(wrappedColumn(z, delta, mask), log2n);
+}
+
+static inline __m256 gather(const HeightField &field, __m256i row,
+                            __m256i column) {
+  return _mm256_i32gather_ps(field.heights, _mm256_add_epi32(row, column), 4);
+}
+
+void sampleHeightsBilinearAVX2(const HeightField &field,
+                               const glm::vec2 *positions, int count,
+                               float *out) {
+  const __m256i mask = _mm256_set1_epi32(field.n - 1);
+  const __m128i log2n = _mm_cvtsi32_si128(field.log2n);
+
+  int i = 0;
+  for (; i + 8 <= count; i += 8) {
+    TexelCoordinates c = texelCoordinates(field, positions + i);
+    __m256i x0 = wrappedColumn(c.x, 0, mask);
+    __m256i x1 = wrappedColumn(c.x, 1, mask);
+    __m256i z0 = wrappedRow(c.z, 0, mask, log2n);
+    __m256i z1 = wrappedRow(c.z, 1, mask, log2n);
+
+    __m256 h00 = gather(field, z0, x0), h10 = gather(field, z0, x1);
+    __m256 h01 = gather(field, z1, x0), h11 = gather(field, z1, x1);
+    __m256 top = _mm256_fmadd_ps(c.tx, _mm256_sub_ps(h10, h00), h00);
+    __m256 bottom = _mm256_fmadd_ps(c.tx, _mm256_sub_ps(h11, h01), h01);
+    _mm256_storeu_ps(out + i,
+                     _mm256_fmadd_ps(c.tz, _mm256_sub_ps(bottom, top), top));
+  }
+  sampleHeightsBilinearScalar(field, positions + i, count - i, out + i);
+}
+
+// Catmull-Rom weights of the texels at -1, 0, 1 and 2
+static inline void catmullRom(__m256 t, __m256 w[4]) {
+  const __m256 half = _mm256_set1_ps(0.5f);
+  __m256 t2 = _mm256_mul_ps(t, t), t3 = _mm256_mul_ps(t2, t);
+  // 0.5 (-t3 + 2 t2 - t)
+  w[0] = _mm256_mul_ps(
+      half, _mm256_sub_ps(_mm256_fmsub_ps(_mm256_set1_ps(2.0f), t2, t3), t));
+  // 0.5 (3 t3 - 5 t2 + 2)
+  w[1] = _mm256_mul_ps(
+      half, _mm256_fmadd_ps(_mm256_set1_ps(3.0f), t3,
+                            _mm256_fnmadd_ps(_mm256_set1_ps(5.0f), t2,
+                                             _mm256_set1_ps(2.0f))));
+  // 0.5 (-3 t3 + 4 t2 + t)
+  w[2] = _mm256_mul_ps(
+      half, _mm256_fnmadd_ps(_mm256_set1_ps(3.0f), t3,
+                             _mm256_fmadd_ps(_mm256_set1_ps(4.0f), t2, t)));
+  // 0.5 (t3 - t2)
+  w[3] = _mm256_mul_ps(half, _mm256_sub_ps(t3, t2));
+}
+
+void sampleHeightsBicubicAVX2(const HeightField &field,
+                              const glm::vec2 *positions, int count,
+                              float *out) {
+  const __m256i mask = _mm256_set1_epi32(field.n - 1);
+  const __m128i log2n = _mm_cvtsi32_si128(field.log2n);
+
+  int i = 0;
+  for (; i + 8 <= count; i += 8) {
+    TexelCoordinates c = texelCoordinates(field, positions + i);
+    __m256 wx[4], wz[4];
+    catmullRom(c.tx, wx);
+    catmullRom(c.tz, wz);
+    __m256i columns[4];
+    for (int k = 0; k < 4; ++k) columns[k] = wrappedColumn(c.x, k - 1, mask);
+
+    __m256 sum = _mm256_setzero_ps();
+    for (int r = 0; r < 4; ++r) {
+      __m256i row = wrappedRow(c.z, r - 1, mask, log2n);
+      __m256 value = _mm256_mul_ps(wx[0], gather(field, row, columns[0]));
+      for (int k = 1; k < 4; ++k) {
+        value = _mm256_fmadd_ps(wx[k], gather(field, row, columns[k]), value);
+      }
+      sum = _mm256_fmadd_ps(wz[r], value, sum);
+    }
+    _mm256_storeu_ps(out + i, sum);
+  }
+  sampleHeightsBicubicScalar(field, positions + i, count - i, out + i);
+}
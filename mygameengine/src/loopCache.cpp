@@ -0,0 +1,175 @@
+#include "loopCache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include "threadPool.h"
+
+using namespace std;
+
+const int LOOP_CACHE_REPORT_INTERVAL = 600;
+
+// channel of value i of a frame: RGBA plane first, then the RG plane
+static inline int channelOf(size_t i, size_t planeSize) {
+  return i < planeSize ? int(i & 3) : 4 + int(i & 1);
+}
+
+bool LoopCache::bake(const char *path, int n, int frames, float period,
+                     const function<const float *(double t)> &evaluate) {
+  auto start = chrono::steady_clock::now();
+
+  const size_t planeSize = size_t(n) * n * 4;
+  const size_t frameSize = size_t(n) * n * LOOP_CACHE_CHANNELS;
+  vector<LoopCacheFrameParams> params(frames);
+  vector<int16_t> quantized(frameSize);
+
+  ofstream out(path, ios::binary);
+  if (!out) {
+    cerr << "Failed to create loop cache " << path << endl;
+    return false;
+  }
+
+  LoopCacheHeader header = {};
+  memcpy(header.magic, LOOP_CACHE_MAGIC, 4);
+  header.version = LOOP_CACHE_VERSION;
+  header.n = n;
+  header.frames = frames;
+  header.period = period;
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  // parameter table is filled in once all frames are quantized
+  out.write(reinterpret_cast<const char *>(params.data()),
+            frames * sizeof(LoopCacheFrameParams));
+
+  for (int k = 0; k < frames; ++k) {
+    const float *fields = evaluate(double(k) * period / frames);
+
+    float lo[LOOP_CACHE_CHANNELS], hi[LOOP_CACHE_CHANNELS];
+    fill(lo, lo + LOOP_CACHE_CHANNELS, INFINITY);
+    fill(hi, hi + LOOP_CACHE_CHANNELS, -INFINITY);
+    for (size_t i = 0; i < frameSize; ++i) {
+      int c = channelOf(i, planeSize);
+      lo[c] = min(lo[c], fields[i]);
+      hi[c] = max(hi[c], fields[i]);
+    }
+
+    LoopCacheFrameParams &p = params[k];
+    for (int c = 0; c < LOOP_CACHE_CHANNELS; ++c) {
+      p.offset[c] = 0.5f * (hi[c] + lo[c]);
+      p.scale[c] = hi[c] > lo[c] ? 0.5f * (hi[c] - lo[c]) / 32767.0f : 1.0f;
+    }
+    for (size_t i = 0; i < frameSize; ++i) {
+      int c = channelOf(i, planeSize);
+      quantized[i] =
+          int16_t(lrintf((fields[i] - p.offset[c]) / p.scale[c]));
+    }
+    out.write(reinterpret_cast<const char *>(quantized.data()),
+              frameSize * sizeof(int16_t));
+  }
+
+  out.seekp(sizeof(header));
+  out.write(reinterpret_cast<const char *>(params.data()),
+            frames * sizeof(LoopCacheFrameParams));
+  out.close();
+  if (!out) {
+    cerr << "Failed to write loop cache " << path << endl;
+    return false;
+  }
+
+  double seconds =
+      chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  size_t bytes = sizeof(header) + frames * sizeof(LoopCacheFrameParams) +
+                 frames * frameSize * sizeof(int16_t);
+  cout << "Baked " << frames << " frames of a " << n << "x" << n << ", "
+       << period << " s loop in " << seconds << " s ("
+       << bytes / (1024.0 * 1024.0) << " MB)" << endl;
+  return true;
+}
+
+bool LoopCache::open(const char *path, int n) {
+  header = nullptr;
+  if (!file.open(path)) return false;
+
+  const LoopCacheHeader *h =
+      static_cast<const LoopCacheHeader *>(file.data());
+  bool valid = file.size() >= sizeof(LoopCacheHeader) &&
+               memcmp(h->magic, LOOP_CACHE_MAGIC, 4) == 0 &&
+               h->version == LOOP_CACHE_VERSION && h->n == n &&
+               h->frames > 0 && h->period > 0.0f;
+  size_t frameSize = size_t(n) * n * LOOP_CACHE_CHANNELS;
+  valid = valid &&
+          file.size() == sizeof(LoopCacheHeader) +
+                             h->frames * sizeof(LoopCacheFrameParams) +
+                             h->frames * frameSize * sizeof(int16_t);
+  if (!valid) {
+    cerr << "Ignoring incompatible loop cache " << path << endl;
+    file.close();
+    return false;
+  }
+
+  header = h;
+  params = reinterpret_cast<const LoopCacheFrameParams *>(h + 1);
+  frameData = reinterpret_cast<const int16_t *>(params + h->frames);
+  cout << "Playing back " << h->frames << " frame loop from " << path << endl;
+  return true;
+}
+
+void LoopCache::sample(double t, float *out) {
+  auto start = chrono::steady_clock::now();
+
+  const int n = header->n;
+  const int frames = header->frames;
+  double position = fmod(t, double(header->period));
+  if (position < 0.0) position += header->period;
+  position *= frames / double(header->period);
+
+  int a = int(position) % frames;
+  int b = (a + 1) % frames;
+  float f = float(position - floor(position));
+
+  // blend of the two dequantized frames, folded into one multiply-add per
+  // frame: out = qa * ca[c] + qb * cb[c] + offset[c]
+  float ca[LOOP_CACHE_CHANNELS], cb[LOOP_CACHE_CHANNELS],
+      offset[LOOP_CACHE_CHANNELS];
+  for (int c = 0; c < LOOP_CACHE_CHANNELS; ++c) {
+    ca[c] = (1.0f - f) * params[a].scale[c];
+    cb[c] = f * params[b].scale[c];
+    offset[c] = (1.0f - f) * params[a].offset[c] + f * params[b].offset[c];
+  }
+
+  const size_t frameSize = size_t(n) * n * LOOP_CACHE_CHANNELS;
+  const size_t planeSize = size_t(n) * n * 4;
+  const int16_t *qa = frameData + a * frameSize;
+  const int16_t *qb = frameData + b * frameSize;
+
+  ThreadPool::shared().parallelFor(0, n, [&](int rowBegin, int rowEnd) {
+    // RGBA plane, 4 channels per texel
+    for (size_t i = size_t(rowBegin) * n * 4; i < size_t(rowEnd) * n * 4;
+         i += 4) {
+      for (int c = 0; c < 4; ++c) {
+        out[i + c] = qa[i + c] * ca[c] + qb[i + c] * cb[c] + offset[c];
+      }
+    }
+    // RG plane
+    for (size_t i = planeSize + size_t(rowBegin) * n * 2;
+         i < planeSize + size_t(rowEnd) * n * 2; i += 2) {
+      for (int c = 0; c < 2; ++c) {
+        out[i + c] =
+            qa[i + c] * ca[4 + c] + qb[i + c] * cb[4 + c] + offset[4 + c];
+      }
+    }
+  });
+
+  sampleSeconds +=
+      chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  if (++sampleCount == LOOP_CACHE_REPORT_INTERVAL) {
+    cout << "Loop playback: " << sampleSeconds * 1000.0 / sampleCount
+         << " ms per frame" << endl;
+    sampleSeconds = 0.0;
+    sampleCount = 0;
+  }
+}
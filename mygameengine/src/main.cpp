@@ -2,6 +2,7 @@
 #include <glad/glad.h>
 // #include <stb/stb_image.h>
 
+#include <cassert>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -12,7 +13,13 @@
 #include "VBO.h"
 #include "camera.h"
 #include "cube.h"
+#include "frameArena.h"
+#include "oceanCascades.h"
+#include "offlineOcean.h"
 #include "shaderClass.h"
+#include "spectrumModels.h"
+#include "taskScheduler.h"
+#include "threadPool.h"
 #include "wave.h"
 
 /*
@@ -28,6 +35,57 @@ using namespace glm;
 
 const unsigned int width = 800;
 const unsigned int height = 600;
+// grid resolution of the single Wave, a power of two from 64 to 4096
+const int waveSize = 256;
+// threads used for the ocean simulation, 0 = one per hardware thread
+const unsigned int simulationThreads = 0;
+// > 0 plays back a baked ocean that repeats every loopPeriod seconds (kiosk
+// and background scenes); it is baked into loopCacheFile on first run
+const float loopPeriod = 0.0f;
+const int loopFrames = 240;
+const char *loopCacheFile = "ocean_loop.cache";
+// > 0 renders the first useCascades cascades summed over a large mesh
+// instead of a single Wave patch, which breaks up the tiling at distance.
+// The swell cascades update at 10 and 30 Hz, the detail every frame.
+const int useCascades = 0;
+const CascadeConfig cascadeConfigs[MAX_OCEAN_CASCADES] = {
+    {256, 1000.0f, 10.0f}, {128, 227.0f, 30.0f}, {128, 53.0f}, {64, 13.0f}};
+// runs the single Wave's simulation on its own thread, so a slow frame of
+// the simulation does not hold up rendering
+const bool asyncSimulation = true;
+// runs each synchronous frame (cascades, or a single Wave without
+// asyncSimulation) as one task graph on the work-stealing scheduler and
+// prints where its time went every frameReportInterval frames
+const bool useFrameGraph = true;
+const int frameReportInterval = 600;
+// also reports the heap allocations of every frameReportInterval frames;
+// once warmed up a frame should make none, and any that does is an error
+const bool reportAllocations = true;
+// prints the cost of every spectrum model's bulk evaluator at startup
+const bool benchmarkSpectra = false;
+// FFT implementation of the ocean simulations; FFT_BACKEND_STOCKHAM keeps
+// FFTW out of the per-frame path for the sizes it supports
+const FFTBackend fftBackend = FFT_BACKEND_FFTW;
+// times both FFT backends at startup
+const bool benchmarkFFT = false;
+// checks the half-spectrum c2r transform against the full c2c one at
+// startup, with both FFT backends
+const bool verifyHalfSpectrum = false;
+// times the simulation passes on 1 up to one thread per hardware thread
+const bool benchmarkThreads = false;
+// stores h0 and the simulated fields as fp16 (not with loopPeriod)
+const bool halfPrecision = false;
+// measures the fp16 storage mode against fp32 at startup
+const bool benchmarkHalf = false;
+// times 100k CPU height queries (sampleHeights) at startup
+const bool benchmarkQueries = false;
+// measures the sparse direct-sum evaluator against the FFT at startup
+const bool benchmarkSparse = false;
+// > 0 renders an offlineSize x offlineSize height field (8192 and up for
+// film work) through memory-mapped scratch files at startup, using at most
+// offlineMemoryBudget bytes of memory whatever its size
+const int offlineSize = 0;
+const size_t offlineMemoryBudget = size_t(256) << 20;
 double preX = -1.0;
 double preY = -1.0;
 
@@ -113,13 +171,62 @@ int main() {
   glClearColor(0.529f, 0.927f, 0.980f, 1.0f);
 
   Shader oceanShader("ocean.vs", "ocean.fs");
+  Shader cascadeShader("oceanCascades.vs", "oceanCascades.fs");
   Shader cubeShader("default.vs", "default.fs");
 
+  ThreadPool::setSharedThreadCount(simulationThreads);
+  TaskScheduler::setSharedThreadCount(simulationThreads);
+  if (benchmarkSpectra) benchmarkSpectrumModels(256, 1000.0f);
+  if (benchmarkFFT) {
+    for (int n = 64; n <= 1024; n *= 2) benchmarkFFTBackends(n, 5);
+  }
+  if (verifyHalfSpectrum) {
+    for (FFTBackend backend : {FFT_BACKEND_FFTW, FFT_BACKEND_STOCKHAM}) {
+      OceanFFT::setBackend(backend);
+      for (int n = 64; n <= 1024; n *= 4) verifyHalfSpectrumFFT(n);
+    }
+  }
+  OceanFFT::setBackend(fftBackend);
+  if (benchmarkThreads) benchmarkThreadScaling();
+  if (benchmarkHalf) {
+    for (int n = 256; n <= 1024; n *= 2) benchmarkHalfPrecision(n);
+  }
+  if (benchmarkQueries) {
+    for (int n = 256; n <= 1024; n *= 4) benchmarkHeightQueries(n);
+  }
+  if (benchmarkSparse) benchmarkSparseOcean(256);
+  if (offlineSize > 0) {
+    OfflineHeightFieldParams offline;
+    offline.n = offlineSize;
+    offline.memoryBudget = offlineMemoryBudget;
+    renderOfflineHeightField(offline);
+  }
+
   // CudaWave wave = CudaWave();
-  Wave wave = Wave();
-  wave.setCamera(&camera);
-  wave.setShader(&oceanShader);
-  wave.generatePhillipsSpectrum();
+  Wave *wave = nullptr;
+  OceanCascades *ocean = nullptr;
+  if (useCascades > 0) {
+    ocean = new OceanCascades(std::vector<CascadeConfig>(
+        cascadeConfigs, cascadeConfigs + useCascades));
+    ocean->setCamera(&camera);
+    ocean->setHalfPrecision(halfPrecision);
+    ocean->setShader(&cascadeShader);
+  } else {
+    WaveConfig config;
+    config.n = waveSize;
+    wave = new Wave(config);
+    wave->setCamera(&camera);
+    wave->setHalfPrecision(halfPrecision);
+    wave->setShader(&oceanShader);
+    if (loopPeriod > 0.0f) {
+      wave->setLoopPeriod(loopPeriod);
+      if (!wave->loadLoop(loopCacheFile) &&
+          wave->bakeLoop(loopCacheFile, loopFrames)) {
+        wave->loadLoop(loopCacheFile);
+      }
+    }
+    if (asyncSimulation) wave->startAsyncSimulation();
+  }
 
   Cube cube(&cubeShader);
 
@@ -129,16 +236,64 @@ int main() {
   glfwSetCursorPosCallback(window, mouse_callback);
   glfwSetScrollCallback(window, mouse_scroll_callback);
 
+  FrameGraph frame;
+  int framesSinceReport = 0;
+  bool warmedUp = false;
+  const bool graphScheduled = useFrameGraph && (ocean || !asyncSimulation);
+  unsigned long long allocationsAtReport = heapAllocationCount();
+
   // Game loop
   while (!glfwWindowShouldClose(window)) {
     glfwPollEvents();
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    wave.update();
+    if (graphScheduled) {
+      // one graph per tick: simulation tasks on every core, the uploads on
+      // this thread as their inputs complete
+      frame.clear();
+      if (ocean) {
+        ocean->scheduleFrame(frame);
+      } else {
+        wave->scheduleFrame(frame);
+      }
+      TaskScheduler::shared().run(frame);
+      if (ocean) {
+        ocean->render();
+      } else {
+        wave->render();
+      }
+    } else if (ocean) {
+      ocean->update();
+    } else {
+      wave->update();
+    }
     cube.render(&camera, vec3(0.0f, 10.0f, 10.0f), vec3(1.0f, 1.0f, 1.0f),
                 vec3(1.0f, 0.0f, 0.0f));
     glfwSwapBuffers(window);
+
+    if (++framesSinceReport == frameReportInterval) {
+      // read before the reports, which allocate and are not part of a frame
+      const unsigned long long allocations =
+          heapAllocationCount() - allocationsAtReport;
+      if (reportAllocations) {
+        cout << "Heap allocations: " << allocations << " in "
+             << frameReportInterval << " frames" << endl;
+        // the first interval holds the warm-up of the arenas and pools
+        if (warmedUp && allocations != 0) {
+          cerr << "Steady-state frames made " << allocations
+               << " heap allocations" << endl;
+        }
+        assert(!warmedUp || allocations == 0);
+      }
+      // the graph of the last frame, still intact until the next clear()
+      if (graphScheduled) frame.report(cout, TaskScheduler::shared().size());
+      framesSinceReport = 0;
+      warmedUp = true;
+      allocationsAtReport = heapAllocationCount();
+    }
   }
 
+  delete ocean;
+  delete wave;
   glfwDestroyWindow(window);
   glfwTerminate();
   return 0;
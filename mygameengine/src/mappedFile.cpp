@@ -0,0 +1,256 @@
+#include "mappedFile.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() { close(); }
+
+#ifdef _WIN32
+
+bool MappedFile::open(const char *path) {
+  close();
+
+  HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) return false;
+
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+    CloseHandle(file);
+    return false;
+  }
+
+  HANDLE mapping =
+      CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!mapping) {
+    CloseHandle(file);
+    return false;
+  }
+
+  void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (!view) {
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return false;
+  }
+
+  file_ = file;
+  mapping_ = mapping;
+  data_ = view;
+  size_ = size_t(fileSize.QuadPart);
+  return true;
+}
+
+void MappedFile::close() {
+  if (data_) UnmapViewOfFile(data_);
+  if (mapping_) CloseHandle(mapping_);
+  if (file_) CloseHandle(file_);
+  data_ = nullptr;
+  mapping_ = nullptr;
+  file_ = nullptr;
+  size_ = 0;
+}
+
+ScratchFile::~ScratchFile() { close(); }
+
+// Offsets of views must be multiples of this
+static size_t viewGranularity() {
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return info.dwAllocationGranularity;
+}
+
+static bool openScratch(const char *path, DWORD disposition, size_t size,
+                        HANDLE *fileOut, HANDLE *mappingOut,
+                        size_t *sizeOut) {
+  HANDLE file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, nullptr,
+                            disposition, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) return false;
+
+  LARGE_INTEGER fileSize;
+  if (disposition == CREATE_ALWAYS) {
+    fileSize.QuadPart = LONGLONG(size);
+    if (!SetFilePointerEx(file, fileSize, nullptr, FILE_BEGIN) ||
+        !SetEndOfFile(file)) {
+      CloseHandle(file);
+      return false;
+    }
+  } else if (!GetFileSizeEx(file, &fileSize)) {
+    CloseHandle(file);
+    return false;
+  }
+  if (fileSize.QuadPart == 0) {
+    CloseHandle(file);
+    return false;
+  }
+
+  HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE,
+                                      fileSize.HighPart, fileSize.LowPart,
+                                      nullptr);
+  if (!mapping) {
+    CloseHandle(file);
+    return false;
+  }
+  *fileOut = file;
+  *mappingOut = mapping;
+  *sizeOut = size_t(fileSize.QuadPart);
+  return true;
+}
+
+bool ScratchFile::create(const char *path, size_t size) {
+  close();
+  return openScratch(path, CREATE_ALWAYS, size, &file_, &mapping_, &size_);
+}
+
+bool ScratchFile::open(const char *path) {
+  close();
+  return openScratch(path, OPEN_EXISTING, 0, &file_, &mapping_, &size_);
+}
+
+void ScratchFile::close() {
+  if (mapping_) CloseHandle(mapping_);
+  if (file_) CloseHandle(file_);
+  mapping_ = nullptr;
+  file_ = nullptr;
+  size_ = 0;
+}
+
+FileView ScratchFile::map(size_t offset, size_t length) {
+  FileView view;
+  if (!mapping_ || length == 0 || offset + length > size_) return view;
+  size_t start = offset - offset % viewGranularity();
+  ULARGE_INTEGER at;
+  at.QuadPart = start;
+  void *base = MapViewOfFile(mapping_, FILE_MAP_READ | FILE_MAP_WRITE,
+                             at.HighPart, at.LowPart, offset - start + length);
+  if (!base) return view;
+  view.base_ = base;
+  view.length_ = offset - start + length;
+  view.data_ = static_cast<char *>(base) + (offset - start);
+  return view;
+}
+
+void FileView::unmap() {
+  if (base_) UnmapViewOfFile(base_);
+  base_ = nullptr;
+  data_ = nullptr;
+  length_ = 0;
+}
+
+#else
+
+bool MappedFile::open(const char *path) {
+  close();
+
+  int fd = ::open(path, O_RDONLY);
+  if (fd < 0) return false;
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size == 0) {
+    ::close(fd);
+    return false;
+  }
+
+  void *view = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+  // the mapping keeps its own reference to the file
+  ::close(fd);
+  if (view == MAP_FAILED) return false;
+
+  data_ = view;
+  size_ = size_t(info.st_size);
+  return true;
+}
+
+void MappedFile::close() {
+  if (data_) munmap(data_, size_);
+  data_ = nullptr;
+  size_ = 0;
+}
+
+ScratchFile::~ScratchFile() { close(); }
+
+bool ScratchFile::create(const char *path, size_t size) {
+  close();
+  if (size == 0) return false;
+
+  int fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) return false;
+  if (ftruncate(fd, off_t(size)) != 0) {
+    ::close(fd);
+    return false;
+  }
+  fd_ = fd;
+  size_ = size;
+  return true;
+}
+
+bool ScratchFile::open(const char *path) {
+  close();
+
+  int fd = ::open(path, O_RDWR);
+  if (fd < 0) return false;
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size == 0) {
+    ::close(fd);
+    return false;
+  }
+  fd_ = fd;
+  size_ = size_t(info.st_size);
+  return true;
+}
+
+void ScratchFile::close() {
+  if (fd_ >= 0) ::close(fd_);
+  fd_ = -1;
+  size_ = 0;
+}
+
+FileView ScratchFile::map(size_t offset, size_t length) {
+  FileView view;
+  if (fd_ < 0 || length == 0 || offset + length > size_) return view;
+  // offsets of mappings must be multiples of the page size
+  const size_t page = size_t(sysconf(_SC_PAGESIZE));
+  size_t start = offset - offset % page;
+  void *base = mmap(nullptr, offset - start + length, PROT_READ | PROT_WRITE,
+                    MAP_SHARED, fd_, off_t(start));
+  if (base == MAP_FAILED) return view;
+  view.base_ = base;
+  view.length_ = offset - start + length;
+  view.data_ = static_cast<char *>(base) + (offset - start);
+  return view;
+}
+
+void FileView::unmap() {
+  if (base_) munmap(base_, length_);
+  base_ = nullptr;
+  data_ = nullptr;
+  length_ = 0;
+}
+
+#endif
+
+FileView::FileView(FileView &&other) noexcept { *this = std::move(other); }
+
+FileView &FileView::operator=(FileView &&other) noexcept {
+  if (this != &other) {
+    unmap();
+    base_ = other.base_;
+    length_ = other.length_;
+    data_ = other.data_;
+    other.base_ = nullptr;
+    other.length_ = 0;
+    other.data_ = nullptr;
+  }
+  return *this;
+}
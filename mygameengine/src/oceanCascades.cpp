@@ -0,0 +1,305 @@
+#include "oceanCascades.h"
+
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+
+using namespace glm;
+using namespace std;
+
+// Vertical scale of the rendered heights, as for a single Wave
+const float CASCADE_HEIGHT_SCALE = 40.0f;
+
+// A cascade hands its wavenumbers over to the next, smaller one at this
+// multiple of the smaller patch's fundamental 2 pi / L
+const float CASCADE_HANDOVER = 6.0f;
+
+const int CASCADE_REPORT_INTERVAL = 600;
+
+OceanCascades::OceanCascades(const vector<CascadeConfig> &configs,
+                             const SpectrumParams &spectrum,
+                             int meshResolution, float meshSize) {
+  int count = std::min(int(configs.size()), MAX_OCEAN_CASCADES);
+  for (int i = 0; i < count; ++i) {
+    const CascadeConfig &config = configs[i];
+
+    // split the spectrum into disjoint bands so no wave is counted twice
+    SpectrumParams band = spectrum;
+    band.minWavenumber =
+        i == 0 ? spectrum.minWavenumber
+               : CASCADE_HANDOVER * 2.0f * pi<float>() / config.patchSize;
+    band.maxWavenumber = i + 1 < count
+                             ? CASCADE_HANDOVER * 2.0f * pi<float>() /
+                                   configs[i + 1].patchSize
+                             : spectrum.maxWavenumber;
+
+    WaveConfig waveConfig;
+    waveConfig.n = config.n;
+    waveConfig.patchSize = config.patchSize;
+    waveConfig.spectrum = band;
+    waveConfig.snapshotPath = "spectrum_cascade" + to_string(i) + ".ocean";
+    Wave *wave = new Wave(waveConfig);
+    // rendered in metres: neighbouring texels are L / N apart
+    wave->setFieldTexelSize(config.patchSize / config.n);
+    cascades.push_back(wave);
+    maxN = std::max(maxN, config.n);
+
+    CascadeSchedule schedule;
+    schedule.period =
+        config.updateRate > 0.0f ? 1.0f / config.updateRate : 0.0f;
+    schedules.push_back(schedule);
+  }
+
+  createSurface(meshResolution, meshSize);
+}
+
+OceanCascades::~OceanCascades() {
+  for (Wave *wave : cascades) delete wave;
+}
+
+void OceanCascades::setShader(Shader *shader) {
+  this->shader = shader;
+  initRenderParams();
+}
+
+void OceanCascades::setChoppiness(float lambda) {
+  choppiness = lambda;
+  for (Wave *wave : cascades) wave->setChoppiness(lambda);
+}
+
+void OceanCascades::setHalfPrecision(bool enabled) {
+  for (Wave *wave : cascades) wave->setHalfPrecision(enabled);
+}
+
+void OceanCascades::createSurface(int resolution, float size) {
+  const float step = size / (resolution - 1);
+  const float shift = size / 2.0f;
+
+  for (int z = 0; z < resolution; ++z) {
+    for (int x = 0; x < resolution; ++x) {
+      vertices.push_back(vec3(x * step - shift, 0.0f, z * step - shift));
+    }
+  }
+
+  for (int z = 0; z < resolution - 1; ++z) {
+    for (int x = 0; x < resolution - 1; ++x) {
+      indices.push_back(z * resolution + x);
+      indices.push_back((z + 1) * resolution + x);
+      indices.push_back(z * resolution + (x + 1));
+
+      indices.push_back((z + 1) * resolution + x);
+      indices.push_back((z + 1) * resolution + (x + 1));
+      indices.push_back(z * resolution + (x + 1));
+    }
+  }
+}
+
+void OceanCascades::initRenderParams() {
+  glGenVertexArrays(1, &VAO);
+  glGenBuffers(1, &VBO);
+  glGenBuffers(1, &EBO);
+
+  glBindVertexArray(VAO);
+  glBindBuffer(GL_ARRAY_BUFFER, VBO);
+  glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(vec3),
+               vertices.data(), GL_STATIC_DRAW);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int),
+               indices.data(), GL_STATIC_DRAW);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vec3), (void *)0);
+  glEnableVertexAttribArray(0);
+  glBindVertexArray(0);
+
+  // The shader wraps and filters the texels itself (each layer may only be
+  // partly used), so no mipmaps and nearest sampling
+  GLuint *maps[2] = {&displacementMaps, &slopeMaps};
+  const bool half = cascades[0]->usesHalfPrecision();
+  const GLenum formats[2] = {half ? GL_RGBA16F : GL_RGBA32F,
+                             half ? GL_RG16F : GL_RG32F};
+  for (int i = 0; i < 2; ++i) {
+    glGenTextures(1, maps[i]);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, *maps[i]);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, formats[i], maxN, maxN,
+                   2 * cascadeCount());
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  }
+  glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+// Simulates cascade i at time t and uploads it into its layer `slot`, or
+// adds that work to frameGraph while a frame is being scheduled
+void OceanCascades::simulateCascade(int i, double t, int slot) {
+  ++cascadeUpdates;
+  if (frameGraph) {
+    // a second update of a cascade in one frame reuses its buffers, so it
+    // waits for the upload of the first
+    CascadeSchedule &s = schedules[i];
+    const char *label = frameGraph->format("cascade %d ", i);
+    TaskId simulated =
+        cascades[i]->addSimulationTasks(*frameGraph, t, {s.lastTask}, label);
+    s.lastTask = frameGraph->addOnCaller(
+        frameGraph->format("%supload", label),
+        [this, i, slot] { uploadCascade(i, slot); }, {simulated});
+    return;
+  }
+
+  cascades[i]->simulate(t);
+  uploadCascade(i, slot);
+}
+
+void OceanCascades::uploadCascade(int i, int slot) {
+  const Wave *wave = cascades[i];
+  const int n = wave->size();
+  const GLenum type = wave->fieldType();
+  const size_t valueSize =
+      wave->usesHalfPrecision() ? sizeof(uint16_t) : sizeof(float);
+  const char *fields = static_cast<const char *>(wave->fields());
+
+  glBindTexture(GL_TEXTURE_2D_ARRAY, displacementMaps);
+  glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, 2 * i + slot, n, n, 1, GL_RGBA,
+                  type, fields);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, slopeMaps);
+  glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, 2 * i + slot, n, n, 1, GL_RG,
+                  type, fields + size_t(n) * n * 4 * valueSize);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+void OceanCascades::scheduleCascade(int i, double now) {
+  CascadeSchedule &s = schedules[i];
+  if (s.period <= 0.0f) {
+    simulateCascade(i, now, 0);
+    s.olderTime = s.newerTime = now;
+    s.newerSlot = 0;
+    return;
+  }
+
+  if (!s.started || now >= s.newerTime + s.period) {
+    // first frame or a long stall: start over around now. Schedules are
+    // staggered by cascade so slow cascades do not all update on one frame.
+    double stagger = s.period * double(i) / cascadeCount();
+    s.olderTime = now - stagger;
+    s.newerTime = s.olderTime + s.period;
+    simulateCascade(i, s.olderTime, 0);
+    simulateCascade(i, s.newerTime, 1);
+    s.newerSlot = 1;
+    s.started = true;
+  } else if (now >= s.newerTime) {
+    // the newer result becomes the older one; the layer it frees gets the
+    // ocean one period ahead
+    s.olderTime = s.newerTime;
+    s.newerTime += s.period;
+    s.newerSlot ^= 1;
+    simulateCascade(i, s.newerTime, s.newerSlot);
+  }
+}
+
+void OceanCascades::advanceClock() {
+  double currentFrame = glfwGetTime();
+  timeStep += currentFrame - lastFrame;
+  lastFrame = currentFrame;
+}
+
+void OceanCascades::scheduleFrame(FrameGraph &graph) {
+  advanceClock();
+  frameGraph = &graph;
+  for (int i = 0; i < cascadeCount(); ++i) {
+    schedules[i].lastTask = -1;
+    scheduleCascade(i, timeStep);
+  }
+  frameGraph = nullptr;
+}
+
+void OceanCascades::update() {
+  advanceClock();
+
+  auto start = chrono::steady_clock::now();
+  for (int i = 0; i < cascadeCount(); ++i) {
+    scheduleCascade(i, timeStep);
+  }
+  simulationSeconds +=
+      chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  if (++simulatedFrames == CASCADE_REPORT_INTERVAL) {
+    cout << "Cascades: " << simulationSeconds * 1000.0 / simulatedFrames
+         << " ms and " << double(cascadeUpdates) / simulatedFrames
+         << " cascade updates per frame" << endl;
+    simulationSeconds = 0.0;
+    simulatedFrames = 0;
+    cascadeUpdates = 0;
+  }
+
+  render();
+}
+
+void OceanCascades::render() {
+  shader->Bind();
+  glBindVertexArray(VAO);
+
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, displacementMaps);
+  glUniform1i(glGetUniformLocation(shader->ID, "displacementMaps"), 0);
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, slopeMaps);
+  glUniform1i(glGetUniformLocation(shader->ID, "slopeMaps"), 1);
+
+  int sizes[MAX_OCEAN_CASCADES] = {};
+  float patchSizes[MAX_OCEAN_CASCADES] = {};
+  int olderLayers[MAX_OCEAN_CASCADES] = {};
+  int newerLayers[MAX_OCEAN_CASCADES] = {};
+  float blends[MAX_OCEAN_CASCADES] = {};
+  for (int i = 0; i < cascadeCount(); ++i) {
+    const CascadeSchedule &s = schedules[i];
+    sizes[i] = cascades[i]->size();
+    patchSizes[i] = cascades[i]->patchSize();
+    newerLayers[i] = 2 * i + s.newerSlot;
+    if (s.period > 0.0f) {
+      olderLayers[i] = 2 * i + (s.newerSlot ^ 1);
+      double blend = (timeStep - s.olderTime) / s.period;
+      blends[i] = float(std::clamp(blend, 0.0, 1.0));
+    } else {
+      olderLayers[i] = newerLayers[i];
+      blends[i] = 1.0f;
+    }
+  }
+  glUniform1i(glGetUniformLocation(shader->ID, "cascadeCount"),
+              cascadeCount());
+  glUniform1iv(glGetUniformLocation(shader->ID, "cascadeSize"),
+               MAX_OCEAN_CASCADES, sizes);
+  glUniform1fv(glGetUniformLocation(shader->ID, "patchSize"),
+               MAX_OCEAN_CASCADES, patchSizes);
+  glUniform1iv(glGetUniformLocation(shader->ID, "olderLayer"),
+               MAX_OCEAN_CASCADES, olderLayers);
+  glUniform1iv(glGetUniformLocation(shader->ID, "newerLayer"),
+               MAX_OCEAN_CASCADES, newerLayers);
+  glUniform1fv(glGetUniformLocation(shader->ID, "cascadeBlend"),
+               MAX_OCEAN_CASCADES, blends);
+  glUniform1f(glGetUniformLocation(shader->ID, "heightScale"),
+              CASCADE_HEIGHT_SCALE);
+  glUniform1f(glGetUniformLocation(shader->ID, "choppiness"), choppiness);
+
+  glm::mat4 model = glm::mat4(1.0f);
+  glm::mat4 view = camera->GetViewMatrix();
+  glm::mat4 projection = camera->GetProjectionMatrix();
+  glUniformMatrix4fv(glGetUniformLocation(shader->ID, "model"), 1, GL_FALSE,
+                     &model[0][0]);
+  glUniformMatrix4fv(glGetUniformLocation(shader->ID, "view"), 1, GL_FALSE,
+                     &view[0][0]);
+  glUniformMatrix4fv(glGetUniformLocation(shader->ID, "projection"), 1,
+                     GL_FALSE, &projection[0][0]);
+
+  glUniform3f(glGetUniformLocation(shader->ID, "lightPosition"), 0.0f, 100.0f,
+              0.0f);
+  glUniform3f(glGetUniformLocation(shader->ID, "lightColor"), 1.0f, 1.0f, 1.0f);
+  glUniform3f(glGetUniformLocation(shader->ID, "waterColorDeep"), 0.0f, 0.0f,
+              0.5f);
+  glUniform3f(glGetUniformLocation(shader->ID, "waterColorShallow"), 0.0f, 0.5f,
+              1.0f);
+
+  glDrawElements(GL_TRIANGLES, GLsizei(indices.size()), GL_UNSIGNED_INT, 0);
+
+  glBindVertexArray(0);
+  glUseProgram(0);
+}
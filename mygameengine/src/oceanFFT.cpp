@@ -0,0 +1,267 @@
+#include "oceanFFT.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "stockhamFFT.h"
+#include "threadPool.h"
+
+using namespace std;
+
+// Lines per call of the split passes; neighbouring columns share cache
+// lines, so a block of them is transformed together
+const int SPLIT_FFT_BLOCK = 8;
+
+static FFTBackend sharedBackend = FFT_BACKEND_FFTW;
+
+OceanFFT::OceanFFT(int n, int channels, FFTMode mode, unsigned planFlags,
+                   int threads)
+    : N(n),
+      channels_(channels),
+      mode_(mode),
+      backend_(sharedBackend),
+      threads_(threads) {
+  width_ = mode_ == FFT_COMPLEX ? N : N / 2 + 1;
+  // FFTW input (frequency domain), one spectrum after the other
+  in_ = fftwf_alloc_complex(channels_ * N * width_);
+  outReal_ = mode_ == FFT_COMPLEX
+                 ? reinterpret_cast<float *>(
+                       fftwf_alloc_complex(channels_ * N * N))
+                 : fftwf_alloc_real(channels_ * N * N);
+
+  if (backend_ == FFT_BACKEND_STOCKHAM) {
+    stockham_ = stockhamPasses(N);
+    if (stockham_) {
+      cout << "Using the Stockham FFT for " << channels_ << " x " << N << "x"
+           << N << (mode_ == FFT_COMPLEX ? " c2c" : " c2r") << endl;
+      return;
+    }
+    cerr << "No Stockham FFT for N = " << N << ", using FFTW" << endl;
+    backend_ = FFT_BACKEND_FFTW;
+  }
+
+  const int dims[2] = {N, N};
+
+  // Reuse plans measured by earlier runs; planning with FFTW_MEASURE or
+  // FFTW_PATIENT is only slow the first time for a given size
+  initThreads();
+  loadWisdom();
+  fftwf_plan_with_nthreads(threads);
+  if (mode_ == FFT_COMPLEX) {
+    fftwf_complex *out = reinterpret_cast<fftwf_complex *>(outReal_);
+    plan_ = fftwf_plan_many_dft(2, dims, channels_, in_, nullptr, 1,
+                                N * width_, out, nullptr, 1, N * N,
+                                FFTW_BACKWARD, planFlags);
+  } else {
+    plan_ = fftwf_plan_many_dft_c2r(2, dims, channels_, in_, nullptr, 1,
+                                    N * width_, outReal_, nullptr, 1, N * N,
+                                    planFlags);
+  }
+  planSplitPasses(planFlags);
+  saveWisdom();
+
+  cout << "Created " << channels_ << " x " << N << "x" << N
+       << (mode_ == FFT_COMPLEX ? " c2c" : " c2r") << " FFT plan on "
+       << threads << " threads" << endl;
+}
+
+OceanFFT::~OceanFFT() {
+  if (!stockham_) {
+    fftwf_destroy_plan(plan_);
+    for (int i = 0; i < 2; ++i) {
+      fftwf_destroy_plan(columnPlans_[i]);
+      fftwf_destroy_plan(rowPlans_[i]);
+    }
+  }
+  fftwf_free(in_);
+  fftwf_free(outReal_);
+}
+
+void OceanFFT::planSplitPasses(unsigned planFlags) {
+  // Every task runs its range on one thread, and ranges start at any line,
+  // so the plans may not assume the alignment of their planning buffers
+  fftwf_plan_with_nthreads(1);
+  planFlags |= FFTW_UNALIGNED;
+  fftwf_complex *out = reinterpret_cast<fftwf_complex *>(outReal_);
+
+  for (int i = 0; i < 2; ++i) {
+    const int lines = i == 0 ? SPLIT_FFT_BLOCK : 1;
+
+    // columns: length N, width_ apart, in place
+    fftwf_iodim column = {N, width_, width_};
+    fftwf_iodim columnBatch[2] = {{channels_, N * width_, N * width_},
+                                  {lines, 1, 1}};
+    columnPlans_[i] = fftwf_plan_guru_dft(1, &column, 2, columnBatch, in_,
+                                          in_, FFTW_BACKWARD, planFlags);
+
+    // rows: length N, from the spectrum into the output
+    fftwf_iodim row = {N, 1, 1};
+    fftwf_iodim rowBatch[2] = {{channels_, N * width_, N * N},
+                               {lines, width_, N}};
+    if (mode_ == FFT_COMPLEX) {
+      rowPlans_[i] = fftwf_plan_guru_dft(1, &row, 2, rowBatch, in_, out,
+                                         FFTW_BACKWARD, planFlags);
+    } else {
+      rowPlans_[i] = fftwf_plan_guru_dft_c2r(1, &row, 2, rowBatch, in_,
+                                             outReal_, planFlags);
+    }
+  }
+}
+
+void OceanFFT::execute() {
+  if (!stockham_) {
+    fftwf_execute(plan_);
+    return;
+  }
+
+  // column blocks, then row blocks, spread over the engine's pool in place
+  // of FFTW's threads
+  if (threads_ > 1) {
+    ThreadPool &pool = ThreadPool::shared();
+    pool.parallelFor(0, width_, [&](int b, int e) { executeColumns(b, e); },
+                     STOCKHAM_LANES);
+    pool.parallelFor(0, N, [&](int b, int e) { executeRows(b, e); },
+                     STOCKHAM_LANES);
+  } else {
+    executeColumns(0, width_);
+    executeRows(0, N);
+  }
+}
+
+void OceanFFT::executeColumns(int begin, int end) {
+  if (stockham_) {
+    for (int c = 0; c < channels_; ++c) {
+      stockham_->columns(input(c), width_, begin, end);
+    }
+    return;
+  }
+  for (int j = begin; j < end;) {
+    bool block = end - j >= SPLIT_FFT_BLOCK;
+    fftwf_execute_dft(columnPlans_[block ? 0 : 1], in_ + j, in_ + j);
+    j += block ? SPLIT_FFT_BLOCK : 1;
+  }
+}
+
+void OceanFFT::executeRows(int begin, int end) {
+  fftwf_complex *out = reinterpret_cast<fftwf_complex *>(outReal_);
+  if (stockham_) {
+    for (int c = 0; c < channels_; ++c) {
+      if (mode_ == FFT_COMPLEX) {
+        stockham_->rows(input(c), out + c * N * N, begin, end);
+      } else {
+        stockham_->rowsReal(input(c), outReal_ + c * N * N, begin, end);
+      }
+    }
+    return;
+  }
+  for (int i = begin; i < end;) {
+    bool block = end - i >= SPLIT_FFT_BLOCK;
+    fftwf_plan plan = rowPlans_[block ? 0 : 1];
+    if (mode_ == FFT_COMPLEX) {
+      fftwf_execute_dft(plan, in_ + i * width_, out + i * N);
+    } else {
+      fftwf_execute_dft_c2r(plan, in_ + i * width_, outReal_ + i * N);
+    }
+    i += block ? SPLIT_FFT_BLOCK : 1;
+  }
+}
+
+void OceanFFT::setBackend(FFTBackend backend) { sharedBackend = backend; }
+
+void OceanFFT::initThreads() {
+  static bool initialized = false;
+  if (initialized) return;
+  initialized = true;
+
+  if (!fftwf_init_threads()) {
+    cerr << "Failed to initialize FFTW threads" << endl;
+  }
+}
+
+void OceanFFT::loadWisdom() {
+  static bool loaded = false;
+  if (loaded) return;
+  loaded = true;
+
+  if (fftwf_import_wisdom_from_filename(FFTW_WISDOM_FILE)) {
+    cout << "Loaded FFTW wisdom from " << FFTW_WISDOM_FILE << endl;
+  }
+}
+
+void OceanFFT::saveWisdom() {
+  if (!fftwf_export_wisdom_to_filename(FFTW_WISDOM_FILE)) {
+    cerr << "Failed to save FFTW wisdom to " << FFTW_WISDOM_FILE << endl;
+  }
+}
+
+void benchmarkFFTBackends(int n, int channels) {
+  const int repeats = 20;
+  const FFTBackend previous = sharedBackend;
+  OceanFFT *ffts[2];
+  for (int b = 0; b < 2; ++b) {
+    sharedBackend = FFTBackend(b);
+    ffts[b] = new OceanFFT(n, channels, FFT_HALF_COMPLEX, FFTW_MEASURE, 1);
+  }
+  sharedBackend = previous;
+
+  // Random bins, with the columns the row pass reads as real (n = 0 and
+  // n = N/2) Hermitian in m, like a height spectrum. Odd channels get an
+  // anti-Hermitian n = N/2 column instead, like the x derivatives of a
+  // Wave: it is imaginary after the column pass, and c2r ignores it.
+  const int width = ffts[0]->spectrumWidth();
+  const size_t bins = size_t(channels) * n * width;
+  vector<float> spectrum(bins * 2);
+  mt19937 rng(1);
+  normal_distribution<float> gaussian;
+  for (float &value : spectrum) value = gaussian(rng);
+  for (int c = 0; c < channels; ++c) {
+    float *s = spectrum.data() + size_t(c) * n * width * 2;
+    for (int j : {0, n / 2}) {
+      const float sign = c % 2 == 1 && j == n / 2 ? -1.0f : 1.0f;
+      for (int i = 0; i <= n / 2; ++i) {
+        int mirror = (n - i) % n;
+        float *bin = s + (i * width + j) * 2;
+        float *partner = s + (mirror * width + j) * 2;
+        if (mirror == i) {
+          bin[sign > 0.0f ? 1 : 0] = 0.0f;
+        } else {
+          partner[0] = sign * bin[0];
+          partner[1] = -sign * bin[1];
+        }
+      }
+    }
+  }
+
+  double seconds[2];
+  for (int b = 0; b < 2; ++b) {
+    // both clobber their input, so every run starts from a fresh copy
+    auto start = chrono::steady_clock::now();
+    for (int r = 0; r < repeats; ++r) {
+      memcpy(ffts[b]->input(), spectrum.data(), bins * sizeof(fftwf_complex));
+      ffts[b]->execute();
+    }
+    seconds[b] =
+        chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  }
+
+  float largest = 0.0f, difference = 0.0f;
+  for (int c = 0; c < channels; ++c) {
+    const float *a = ffts[0]->outputReal(c), *b = ffts[1]->outputReal(c);
+    for (int i = 0; i < n * n; ++i) {
+      largest = std::max(largest, std::abs(a[i]));
+      difference = std::max(difference, std::abs(a[i] - b[i]));
+    }
+  }
+
+  cout << channels << " x " << n << "x" << n << " c2r FFT: FFTW "
+       << seconds[0] * 1000.0 / repeats << " ms, "
+       << (ffts[1]->backend() == FFT_BACKEND_STOCKHAM ? "Stockham " : "FFTW ")
+       << seconds[1] * 1000.0 / repeats << " ms, largest difference "
+       << difference / std::max(largest, 1e-30f) << " of the peak" << endl;
+  for (OceanFFT *fft : ffts) delete fft;
+}
@@ -0,0 +1,359 @@
+#include "offlineOcean.h"
+
+#include <fftw3.h>
+
+#include <algorithm>
+#include <chrono>
+#include <complex>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "mappedFile.h"
+#include "spectrumKernels.h"
+#include "spectrumSnapshot.h"
+#include "threadPool.h"
+
+using namespace std;
+
+typedef complex<float> Complex;
+
+static const float TWO_PI = 6.28318530718f;
+
+static bool isMapped(const FileView &view, const char *path) {
+  if (!view.isMapped()) cerr << "Failed to map " << path << endl;
+  return view.isMapped();
+}
+
+// Per thread scratch of the row passes, grown to the largest size once
+static float *rowScratch(size_t floats) {
+  static thread_local vector<float> scratch;
+  if (scratch.size() < floats) scratch.resize(floats);
+  return scratch.data();
+}
+
+// Pass 1: h0 as a spectrum snapshot, generated a band of rows at a time
+// unless the file already holds it
+static bool prepareSpectrum(const OfflineHeightFieldParams &params,
+                            const SpectrumGrid &grid, ScratchFile &h0File) {
+  const SpectrumSnapshotHeader expected = makeSpectrumSnapshotHeader(grid);
+  const size_t headerBytes = sizeof(SpectrumSnapshotHeader);
+  if (h0File.open(params.spectrumPath)) {
+    FileView header = h0File.map(0, headerBytes);
+    if (header.isMapped() &&
+        SpectrumSnapshot::isValid(
+            *static_cast<const SpectrumSnapshotHeader *>(header.data()),
+            expected, h0File.size())) {
+      cout << "Loaded spectrum snapshot " << params.spectrumPath << endl;
+      return true;
+    }
+    cout << "Spectrum snapshot " << params.spectrumPath
+         << " is stale, regenerating" << endl;
+    h0File.close();
+  }
+
+  const int n = grid.n;
+  const size_t rowBytes = size_t(n) * sizeof(Complex);
+  if (!h0File.create(params.spectrumPath, headerBytes + n * rowBytes)) {
+    cerr << "Failed to create " << params.spectrumPath << endl;
+    return false;
+  }
+  const int bandRows =
+      int(std::clamp<size_t>(params.memoryBudget / rowBytes, 1, n));
+  for (int begin = 0; begin < n; begin += bandRows) {
+    const int end = std::min(n, begin + bandRows);
+    FileView band = h0File.map(headerBytes + begin * rowBytes,
+                               (end - begin) * rowBytes);
+    if (!isMapped(band, params.spectrumPath)) return false;
+    Complex *rows = static_cast<Complex *>(band.data());
+    ThreadPool::shared().parallelFor(begin, end, [&](int rowBegin,
+                                                     int rowEnd) {
+      generateSpectrumRows(grid, rowBegin, rowEnd,
+                           rows + size_t(rowBegin - begin) * n);
+    });
+  }
+
+  // the header goes in last, so an interrupted run leaves a stale snapshot
+  FileView header = h0File.map(0, headerBytes);
+  if (!isMapped(header, params.spectrumPath)) return false;
+  SpectrumSnapshotHeader stored = expected;
+  memcpy(stored.magic, SPECTRUM_SNAPSHOT_MAGIC, 4);
+  stored.version = SPECTRUM_SNAPSHOT_VERSION;
+  memcpy(header.data(), &stored, headerBytes);
+  cout << "Saved spectrum snapshot " << params.spectrumPath << endl;
+  return true;
+}
+
+// Bins of a row evolved at a time, so the per thread scratch stays small
+// whatever N
+static const int EVOLVE_CHUNK = 512;
+
+// Paired planes and w(k) of one chunk, for every thread of the pool
+static size_t evolveScratchBytes() {
+  return size_t(ThreadPool::shared().size()) * 5 * EVOLVE_CHUNK *
+         sizeof(float);
+}
+
+// Pass 2: h(K, t) in FFTW's half spectrum order, N rows of N/2 + 1 bins.
+// Same bins and kernels as Wave::evolveRows, with the paired planes of a
+// row built from the two h0 rows it needs. Row i reads h0 rows
+// (i + N/2) % N and (N/2 - i) % N; within a band that does not cross row
+// N/2 or N/2 + 1 both are contiguous, so each is mapped once per band and
+// shared by the workers.
+static bool evolveSpectrum(const OfflineHeightFieldParams &params,
+                           ScratchFile &h0File, ScratchFile &spectrumFile) {
+  const int n = params.n;
+  const int width = n / 2 + 1;
+  const size_t headerBytes = sizeof(SpectrumSnapshotHeader);
+  const size_t h0RowBytes = size_t(n) * sizeof(Complex);
+  const size_t rowBytes = size_t(width) * sizeof(Complex);
+  const EvolveSpectrumFn evolve = selectEvolveSpectrumKernel();
+
+  // every band row maps one output row and two h0 rows
+  const size_t rowsBudget = params.memoryBudget - evolveScratchBytes();
+  const int bandRows = int(
+      std::clamp<size_t>(rowsBudget / (rowBytes + 2 * h0RowBytes), 1, n));
+  for (int begin = 0, end; begin < n; begin = end) {
+    end = std::min(n, begin + bandRows);
+    for (int split : {n / 2, n / 2 + 1}) {
+      if (begin < split && end > split) end = split;
+    }
+    const size_t count = size_t(end - begin);
+    const int first = (begin + n / 2) % n;
+    const int firstMirror = (n + n / 2 - (end - 1)) % n;
+    FileView band = spectrumFile.map(begin * rowBytes, count * rowBytes);
+    FileView h0Band =
+        h0File.map(headerBytes + first * h0RowBytes, count * h0RowBytes);
+    FileView mirrorBand = h0File.map(
+        headerBytes + firstMirror * h0RowBytes, count * h0RowBytes);
+    if (!isMapped(band, params.scratchPath) ||
+        !isMapped(h0Band, params.spectrumPath) ||
+        !isMapped(mirrorBand, params.spectrumPath)) {
+      return false;
+    }
+    Complex *rows = static_cast<Complex *>(band.data());
+    const Complex *h0Rows = static_cast<const Complex *>(h0Band.data());
+    const Complex *mirrorRows =
+        static_cast<const Complex *>(mirrorBand.data());
+
+    ThreadPool::shared().parallelFor(begin, end, [&](int rowBegin,
+                                                     int rowEnd) {
+      float *planes = rowScratch(5 * EVOLVE_CHUNK);
+      float *omega = planes + 4 * EVOLVE_CHUNK;
+      for (int i = rowBegin; i < rowEnd; ++i) {
+        const int m = i <= n / 2 ? i : i - n;
+        const Complex *h0 = h0Rows + size_t((i + n / 2) % n - first) * n;
+        const Complex *mirror =
+            mirrorRows + size_t((n + n / 2 - i) % n - firstMirror) * n;
+        Complex *out = rows + size_t(i - begin) * width;
+
+        for (int j0 = 0; j0 < width; j0 += EVOLVE_CHUNK) {
+          const int bins = std::min(EVOLVE_CHUNK, width - j0);
+          for (int b = 0; b < bins; ++b) {
+            const int j = j0 + b;
+            Complex h = h0[(j + n / 2) % n];
+            Complex partner = conj(mirror[(n / 2 - j) % n]);
+            planes[b] = h.real();
+            planes[EVOLVE_CHUNK + b] = h.imag();
+            planes[2 * EVOLVE_CHUNK + b] = partner.real();
+            planes[3 * EVOLVE_CHUNK + b] = partner.imag();
+            float kx = TWO_PI * j / params.patchSize;
+            float kz = TWO_PI * m / params.patchSize;
+            omega[b] = dispersionOmega(params.dispersion, params.gravity,
+                                       sqrt(kx * kx + kz * kz));
+          }
+          PairedSpectrumRun run = {planes, planes + EVOLVE_CHUNK,
+                                   planes + 2 * EVOLVE_CHUNK,
+                                   planes + 3 * EVOLVE_CHUNK};
+          evolve(run, omega, bins, params.time, out + j0);
+        }
+      }
+    });
+  }
+  return true;
+}
+
+// Pass 3: the column transforms in place, on slabs of columns that are
+// gathered from bands of rows into a contiguous buffer and scattered back
+static bool transformColumns(const OfflineHeightFieldParams &params,
+                             ScratchFile &spectrumFile) {
+  const int n = params.n;
+  const int width = n / 2 + 1;
+  const size_t rowBytes = size_t(width) * sizeof(Complex);
+  // half the budget for the slab, half for the mapped rows
+  const int slabColumns = int(std::clamp<size_t>(
+      params.memoryBudget / 2 / (n * sizeof(Complex)), 1, width));
+  const int bandRows =
+      int(std::clamp<size_t>(params.memoryBudget / 2 / rowBytes, 1, n));
+
+  // column c of the slab is n contiguous bins
+  fftwf_complex *slab = fftwf_alloc_complex(size_t(slabColumns) * n);
+  fftwf_plan_with_nthreads(1);
+  fftwf_plan plan =
+      fftwf_plan_dft_1d(n, slab, slab, FFTW_BACKWARD, FFTW_ESTIMATE);
+
+  bool ok = true;
+  for (int c0 = 0; c0 < width && ok; c0 += slabColumns) {
+    const int columns = std::min(slabColumns, width - c0);
+
+    // gather, then scatter with the same bands
+    for (int direction = 0; direction < 2 && ok; ++direction) {
+      if (direction == 1) {
+        ThreadPool::shared().parallelFor(0, columns, [&](int begin, int end) {
+          for (int c = begin; c < end; ++c) {
+            fftwf_execute_dft(plan, slab + size_t(c) * n,
+                              slab + size_t(c) * n);
+          }
+        });
+      }
+      for (int begin = 0; begin < n; begin += bandRows) {
+        const int end = std::min(n, begin + bandRows);
+        FileView band =
+            spectrumFile.map(begin * rowBytes, (end - begin) * rowBytes);
+        if (!isMapped(band, params.scratchPath)) {
+          ok = false;
+          break;
+        }
+        fftwf_complex *rows = static_cast<fftwf_complex *>(band.data());
+        ThreadPool::shared().parallelFor(begin, end, [&](int rowBegin,
+                                                         int rowEnd) {
+          for (int r = rowBegin; r < rowEnd; ++r) {
+            fftwf_complex *row = rows + size_t(r - begin) * width + c0;
+            for (int c = 0; c < columns; ++c) {
+              fftwf_complex *bin = slab + size_t(c) * n + r;
+              float *from = direction == 0 ? row[c] : *bin;
+              float *to = direction == 0 ? *bin : row[c];
+              to[0] = from[0];
+              to[1] = from[1];
+            }
+          }
+        });
+      }
+    }
+  }
+
+  fftwf_destroy_plan(plan);
+  fftwf_free(slab);
+  return ok;
+}
+
+// Pass 4: complex to real row transforms straight from the scratch file
+// into the mapped output, scaled like the Wave's height channel
+static bool transformRows(const OfflineHeightFieldParams &params,
+                          ScratchFile &spectrumFile) {
+  const int n = params.n;
+  const int width = n / 2 + 1;
+  const size_t rowBytes = size_t(width) * sizeof(Complex);
+  const size_t outputRowBytes = size_t(n) * sizeof(float);
+
+  // PFM header; the scale is padded with zeros so the rows start 16 byte
+  // aligned. A negative scale means little endian.
+  string header = "Pf\n" + to_string(n) + " " + to_string(n) + "\n-1.";
+  while ((header.size() + 1) % 16 != 0) header += '0';
+  header += '\n';
+
+  ScratchFile output;
+  if (!output.create(params.outputPath, header.size() + n * outputRowBytes)) {
+    cerr << "Failed to create " << params.outputPath << endl;
+    return false;
+  }
+  {
+    FileView view = output.map(0, header.size());
+    if (!isMapped(view, params.outputPath)) return false;
+    memcpy(view.data(), header.data(), header.size());
+  }
+
+  fftwf_complex *in = fftwf_alloc_complex(width);
+  float *out = fftwf_alloc_real(n);
+  fftwf_plan_with_nthreads(1);
+  // the rows of the scratch file are only 8 byte aligned
+  fftwf_plan plan = fftwf_plan_dft_c2r_1d(
+      n, in, out, FFTW_ESTIMATE | FFTW_UNALIGNED | FFTW_DESTROY_INPUT);
+  const float scale = 1.0f / (float(n) * float(n));
+
+  bool ok = true;
+  const int bandRows = int(std::clamp<size_t>(
+      params.memoryBudget / (rowBytes + outputRowBytes), 1, n));
+  for (int begin = 0; begin < n; begin += bandRows) {
+    const int end = std::min(n, begin + bandRows);
+    FileView band =
+        spectrumFile.map(begin * rowBytes, (end - begin) * rowBytes);
+    // PFM stores the bottom row first, field row i is file row n - 1 - i
+    FileView heights = output.map(header.size() + (n - end) * outputRowBytes,
+                                  (end - begin) * outputRowBytes);
+    if (!isMapped(band, params.scratchPath) ||
+        !isMapped(heights, params.outputPath)) {
+      ok = false;
+      break;
+    }
+    fftwf_complex *rows = static_cast<fftwf_complex *>(band.data());
+    float *field = static_cast<float *>(heights.data());
+
+    ThreadPool::shared().parallelFor(begin, end, [&](int rowBegin,
+                                                     int rowEnd) {
+      for (int i = rowBegin; i < rowEnd; ++i) {
+        float *row = field + size_t(end - 1 - i) * n;
+        fftwf_execute_dft_c2r(plan, rows + size_t(i - begin) * width, row);
+        for (int x = 0; x < n; ++x) row[x] *= scale;
+      }
+    });
+    // unmapping hands the finished rows to the OS to write out
+    heights.unmap();
+    cout << "Offline height field: " << end << " / " << n << " rows" << endl;
+  }
+
+  fftwf_destroy_plan(plan);
+  fftwf_free(out);
+  fftwf_free(in);
+  return ok;
+}
+
+bool renderOfflineHeightField(const OfflineHeightFieldParams &requested) {
+  OfflineHeightFieldParams params = requested;
+  const int n = params.n;
+  if (n < 4 || (n & (n - 1)) != 0) {
+    cerr << "Offline height field size " << n << " is not a power of two"
+         << endl;
+    return false;
+  }
+  // every pass needs at least one column and one row of the spectrum, the
+  // evolve pass also its scratch per thread
+  const size_t minimumBudget =
+      4 * size_t(n) * sizeof(Complex) + evolveScratchBytes();
+  if (params.memoryBudget < minimumBudget) {
+    cerr << "Offline memory budget of " << params.memoryBudget
+         << " bytes is too small for " << n << " x " << n << ", using "
+         << minimumBudget << endl;
+    params.memoryBudget = minimumBudget;
+  }
+  cout << "Rendering " << n << " x " << n << " height field at t = "
+       << params.time << " within " << (params.memoryBudget >> 20) << " MB"
+       << endl;
+  auto start = chrono::steady_clock::now();
+
+  const SpectrumGrid grid = {n, params.patchSize, params.gravity, params.seed,
+                             params.spectrum};
+  ScratchFile h0File, spectrumFile;
+  bool ok = prepareSpectrum(params, grid, h0File);
+  if (ok) {
+    ok = spectrumFile.create(params.scratchPath,
+                             size_t(n) * (n / 2 + 1) * sizeof(Complex));
+    if (!ok) cerr << "Failed to create " << params.scratchPath << endl;
+  }
+  ok = ok && evolveSpectrum(params, h0File, spectrumFile) &&
+       transformColumns(params, spectrumFile) &&
+       transformRows(params, spectrumFile);
+
+  h0File.close();
+  spectrumFile.close();
+  remove(params.scratchPath);
+  if (ok) {
+    double seconds =
+        chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "Saved height field " << params.outputPath << " in " << seconds
+         << " s" << endl;
+  }
+  return ok;
+}
@@ -0,0 +1,125 @@
+#include "sparseOcean.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <numeric>
+
+#include "cpuFeatures.h"
+
+using namespace std;
+
+static const double TWO_PI = 6.283185307179586476925286766559;
+
+// Per thread phases of one evaluation, grown to the largest size once
+static float *phaseScratch(int floats) {
+  static thread_local vector<float> scratch;
+  if (int(scratch.size()) < floats) scratch.resize(floats);
+  return scratch.data();
+}
+
+float sumSparseBinsScalar(const SparseOceanBins &bins, float x, float z) {
+  float sum = 0.0f;
+  for (int i = 0; i < bins.count; ++i) {
+    float theta = bins.kx[i] * x + bins.kz[i] * z + bins.phase[i];
+    sum += bins.re[i] * std::cos(theta) - bins.im[i] * std::sin(theta);
+  }
+  return sum;
+}
+
+SumSparseBinsFn selectSumSparseBinsKernel() {
+  if (cpuFeatures().avx2) return sumSparseBinsAVX2;
+  return sumSparseBinsScalar;
+}
+
+SparseOcean::SparseOcean(const complex<float> *h0, int n, float patchSize,
+                         const SparseOceanParams &params)
+    : patchSize_(patchSize),
+      metresPerUnit_(params.metresPerUnit),
+      originMetres_(params.originMetres),
+      sumBins_(selectSumSparseBinsKernel()) {
+  const int total = n * n;
+  bins_ = std::clamp(params.bins, 1, total);
+  padded_ = (bins_ + SPARSE_OCEAN_LANES - 1) / SPARSE_OCEAN_LANES *
+            SPARSE_OCEAN_LANES;
+
+  // the bins_ largest amplitudes first, in no particular order
+  vector<int> order(total);
+  iota(order.begin(), order.end(), 0);
+  nth_element(order.begin(), order.begin() + (bins_ - 1), order.end(),
+              [h0](int a, int b) { return norm(h0[a]) > norm(h0[b]); });
+
+  // every bin and its conjugate partner add up to twice the real part, and
+  // the FFT output is normalized by 1 / N^2
+  const float amplitude = 2.0f / (float(n) * float(n)) * params.heightScale;
+  planes_.assign(size_t(4) * padded_, 0.0f);
+  omega_.assign(padded_, 0.0f);
+  float *kx = planes_.data(), *kz = kx + padded_;
+  float *re = kz + padded_, *im = re + padded_;
+  double keptEnergy = 0.0, droppedEnergy = 0.0, droppedAmplitude = 0.0;
+  for (int b = 0; b < total; ++b) {
+    const int bin = order[b];
+    const double energy = norm(h0[bin]);
+    if (b >= bins_) {
+      droppedEnergy += energy;
+      droppedAmplitude += sqrt(energy);
+      continue;
+    }
+    keptEnergy += energy;
+    // centered grid: row i, column j hold K = 2 pi (j - n/2, i - n/2) / L
+    glm::vec2 K = float(TWO_PI) / patchSize *
+                  glm::vec2(bin % n - n / 2, bin / n - n / 2);
+    kx[b] = K.x;
+    kz[b] = K.y;
+    re[b] = amplitude * h0[bin].real();
+    im[b] = amplitude * h0[bin].imag();
+    omega_[b] = loopOmega(
+        dispersionOmega(params.dispersion, params.gravity, glm::length(K)),
+        params.loopPeriod);
+  }
+
+  errorBound_ = float(amplitude * droppedAmplitude);
+  rmsError_ = float(amplitude * sqrt(droppedEnergy / 2.0));
+  const double totalEnergy = keptEnergy + droppedEnergy;
+  energyFraction_ = totalEnergy > 0.0 ? float(keptEnergy / totalEnergy) : 1.0f;
+  cout << "Sparse ocean: " << bins_ << " of " << total << " bins, "
+       << energyFraction_ * 100.0f << "% of the energy, error <= "
+       << errorBound_ << " (rms " << rmsError_ << ")" << endl;
+}
+
+void SparseOcean::phases(double t, float *phase) const {
+  // reduced in double: w t reaches thousands of radians within minutes,
+  // where a float has lost the fraction that matters
+  for (int b = 0; b < padded_; ++b) {
+    double cycles = double(omega_[b]) * t * (1.0 / TWO_PI);
+    phase[b] = float(TWO_PI * (cycles - floor(cycles)));
+  }
+}
+
+float SparseOcean::height(const float *phase, glm::vec2 position) const {
+  // every K is a multiple of 2 pi / L, so positions wrap into the patch
+  // around the origin, which keeps the sincos arguments small
+  float x = position.x * metresPerUnit_ + originMetres_;
+  float z = position.y * metresPerUnit_ + originMetres_;
+  x -= patchSize_ * std::floor(x / patchSize_ + 0.5f);
+  z -= patchSize_ * std::floor(z / patchSize_ + 0.5f);
+
+  const float *kx = planes_.data(), *kz = kx + padded_;
+  const float *re = kz + padded_, *im = re + padded_;
+  SparseOceanBins bins = {kx, kz, phase, re, im, padded_};
+  return sumBins_(bins, x, z);
+}
+
+float SparseOcean::evaluate(glm::vec2 position, double t) const {
+  float *phase = phaseScratch(padded_);
+  phases(t, phase);
+  return height(phase, position);
+}
+
+void SparseOcean::evaluate(span<const glm::vec2> positions, double t,
+                           span<float> heights) const {
+  float *phase = phaseScratch(padded_);
+  phases(t, phase);
+  const size_t count = std::min(positions.size(), heights.size());
+  for (size_t i = 0; i < count; ++i) heights[i] = height(phase, positions[i]);
+}
@@ -0,0 +1,31 @@
+// Compiled with /arch:AVX2, only called when cpuFeatures() reports AVX2.
+#include "sparseOcean.h"
+
+#if defined(__GNUC__) && !defined(__AVX2__)
+#pragma GCC target("avx2,fma")
+#endif
+
+#define SIMD_MATH_AVX2
+#include "simdMath.h"
+
+float sumSparseBinsAVX2(const SparseOceanBins &bins, float x, float z) {
+  const __m256 vx = _mm256_set1_ps(x), vz = _mm256_set1_ps(z);
+  __m256 sum = _mm256_setzero_ps();
+  // count is padded to whole vectors
+  for (int i = 0; i < bins.count; i += 8) {
+    __m256 theta = _mm256_fmadd_ps(
+        _mm256_loadu_ps(bins.kx + i), vx,
+        _mm256_fmadd_ps(_mm256_loadu_ps(bins.kz + i), vz,
+                        _mm256_loadu_ps(bins.phase + i)));
+    __m256 s, c;
+    sincos256(theta, &s, &c);
+    sum = _mm256_fmadd_ps(_mm256_loadu_ps(bins.re + i), c, sum);
+    sum = _mm256_fnmadd_ps(_mm256_loadu_ps(bins.im + i), s, sum);
+  }
+
+  __m128 half = _mm_add_ps(_mm256_castps256_ps128(sum),
+                           _mm256_extractf128_ps(sum, 1));
+  half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+  half = _mm_add_ss(half, _mm_movehdup_ps(half));
+  return _mm_cvtss_f32(half);
+}
@@ -0,0 +1,59 @@
+#include "spectrumKernels.h"
+
+#include <cmath>
+
+#include "cpuFeatures.h"
+
+void evolveSpectrumScalar(const PairedSpectrumRun &h0, const float *w,
+                          int count, float t, std::complex<float> *out) {
+  for (int i = 0; i < count; ++i) {
+    // one sincos gives both e^(iwt) and its conjugate e^(-iwt)
+    float c = std::cos(w[i] * t);
+    float s = std::sin(w[i] * t);
+
+    // h0(K) e^(iwt) + conj(h0(-K)) e^(-iwt), expanded
+    out[i] = std::complex<float>(
+        (h0.re[i] + h0.mirrorRe[i]) * c - (h0.im[i] - h0.mirrorIm[i]) * s,
+        (h0.re[i] - h0.mirrorRe[i]) * s + (h0.im[i] + h0.mirrorIm[i]) * c);
+  }
+}
+
+void evolveSpectrumRotorScalar(const PairedSpectrumRun &h0,
+                               const float *rotorRe, const float *rotorIm,
+                               float *phaseRe, float *phaseIm, int count,
+                               std::complex<float> *out) {
+  for (int i = 0; i < count; ++i) {
+    float c = phaseRe[i] * rotorRe[i] - phaseIm[i] * rotorIm[i];
+    float s = phaseRe[i] * rotorIm[i] + phaseIm[i] * rotorRe[i];
+    phaseRe[i] = c;
+    phaseIm[i] = s;
+
+    // h0(K) p + conj(h0(-K)) conj(p), expanded
+    out[i] = std::complex<float>(
+        (h0.re[i] + h0.mirrorRe[i]) * c - (h0.im[i] - h0.mirrorIm[i]) * s,
+        (h0.re[i] - h0.mirrorRe[i]) * s + (h0.im[i] + h0.mirrorIm[i]) * c);
+  }
+}
+
+void renormalizePhases(float *phaseRe, float *phaseIm, int count) {
+  for (int i = 0; i < count; ++i) {
+    float scale = 1.0f / std::sqrt(phaseRe[i] * phaseRe[i] +
+                                   phaseIm[i] * phaseIm[i]);
+    phaseRe[i] *= scale;
+    phaseIm[i] *= scale;
+  }
+}
+
+EvolveSpectrumFn selectEvolveSpectrumKernel() {
+  const CpuFeatures &cpu = cpuFeatures();
+  if (cpu.avx512) return evolveSpectrumAVX512;
+  if (cpu.avx2) return evolveSpectrumAVX2;
+  return evolveSpectrumScalar;
+}
+
+EvolveSpectrumRotorFn selectEvolveSpectrumRotorKernel() {
+  const CpuFeatures &cpu = cpuFeatures();
+  if (cpu.avx512) return evolveSpectrumRotorAVX512;
+  if (cpu.avx2) return evolveSpectrumRotorAVX2;
+  return evolveSpectrumRotorScalar;
+}
@@ -0,0 +1,82 @@
+// Compiled with /arch:AVX2, only called when cpuFeatures() reports AVX2.
+// Sticks to raw float pointers so no inline library code is instantiated
+// with AVX2 instructions in this translation unit.
+#include "spectrumKernels.h"
+
+#if defined(__GNUC__) && !defined(__AVX2__)
+#pragma GCC target("avx2,fma")
+#endif
+
+#define SIMD_MATH_AVX2
+#include "simdMath.h"
+
+// h0(K) e^(iwt) + conj(h0(-K)) e^(-iwt) for bins i..i+7, interleaved into
+// out; (c, s) is e^(iwt)
+static inline void combine(const PairedSpectrumRun &h0, int i, __m256 c,
+                           __m256 s, float *out) {
+  __m256 aRe = _mm256_loadu_ps(h0.re + i);
+  __m256 aIm = _mm256_loadu_ps(h0.im + i);
+  __m256 mRe = _mm256_loadu_ps(h0.mirrorRe + i);
+  __m256 mIm = _mm256_loadu_ps(h0.mirrorIm + i);
+
+  __m256 re = _mm256_fmsub_ps(_mm256_add_ps(aRe, mRe), c,
+                              _mm256_mul_ps(_mm256_sub_ps(aIm, mIm), s));
+  __m256 im = _mm256_fmadd_ps(_mm256_sub_ps(aRe, mRe), s,
+                              _mm256_mul_ps(_mm256_add_ps(aIm, mIm), c));
+
+  // unpack interleaves within 128-bit lanes, the permutes put the lanes back
+  // in bin order
+  __m256 lo = _mm256_unpacklo_ps(re, im);
+  __m256 hi = _mm256_unpackhi_ps(re, im);
+  _mm256_storeu_ps(out + 2 * i, _mm256_permute2f128_ps(lo, hi, 0x20));
+  _mm256_storeu_ps(out + 2 * i + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+}
+
+void evolveSpectrumAVX2(const PairedSpectrumRun &h0, const float *w,
+                        int count, float t, std::complex<float> *out) {
+  float *o = reinterpret_cast<float *>(out);
+  const __m256 time = _mm256_set1_ps(t);
+
+  int i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256 s, c;
+    sincos256(_mm256_mul_ps(_mm256_loadu_ps(w + i), time), &s, &c);
+    combine(h0, i, c, s, o);
+  }
+
+  if (i < count) {
+    PairedSpectrumRun tail = {h0.re + i, h0.im + i, h0.mirrorRe + i,
+                              h0.mirrorIm + i};
+    evolveSpectrumScalar(tail, w + i, count - i, t, out + i);
+  }
+}
+
+void evolveSpectrumRotorAVX2(const PairedSpectrumRun &h0,
+                             const float *rotorRe, const float *rotorIm,
+                             float *phaseRe, float *phaseIm, int count,
+                             std::complex<float> *out) {
+  float *o = reinterpret_cast<float *>(out);
+
+  int i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256 rRe = _mm256_loadu_ps(rotorRe + i);
+    __m256 rIm = _mm256_loadu_ps(rotorIm + i);
+    __m256 pRe = _mm256_loadu_ps(phaseRe + i);
+    __m256 pIm = _mm256_loadu_ps(phaseIm + i);
+
+    // p *= r
+    __m256 c = _mm256_fmsub_ps(pRe, rRe, _mm256_mul_ps(pIm, rIm));
+    __m256 s = _mm256_fmadd_ps(pRe, rIm, _mm256_mul_ps(pIm, rRe));
+    _mm256_storeu_ps(phaseRe + i, c);
+    _mm256_storeu_ps(phaseIm + i, s);
+
+    combine(h0, i, c, s, o);
+  }
+
+  if (i < count) {
+    PairedSpectrumRun tail = {h0.re + i, h0.im + i, h0.mirrorRe + i,
+                              h0.mirrorIm + i};
+    evolveSpectrumRotorScalar(tail, rotorRe + i, rotorIm + i, phaseRe + i,
+                              phaseIm + i, count - i, out + i);
+  }
+}
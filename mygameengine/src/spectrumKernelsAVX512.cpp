@@ -0,0 +1,82 @@
+// Compiled with /arch:AVX512, only called when cpuFeatures() reports
+// AVX-512F. Sticks to raw float pointers so no inline library code is
+// instantiated with AVX-512 instructions in this translation unit.
+#include "spectrumKernels.h"
+
+#if defined(__GNUC__) && !defined(__AVX512F__)
+#pragma GCC target("avx512f,avx2,fma")
+#endif
+
+#define SIMD_MATH_AVX512
+#include "simdMath.h"
+
+// h0(K) e^(iwt) + conj(h0(-K)) e^(-iwt) for bins i..i+15, interleaved into
+// out; (c, s) is e^(iwt)
+static inline void combine(const PairedSpectrumRun &h0, int i, __m512 c,
+                           __m512 s, float *out) {
+  const __m512i loIdx = _mm512_setr_epi32(0, 16, 1, 17, 2, 18, 3, 19, 4, 20,
+                                          5, 21, 6, 22, 7, 23);
+  const __m512i hiIdx = _mm512_setr_epi32(8, 24, 9, 25, 10, 26, 11, 27, 12,
+                                          28, 13, 29, 14, 30, 15, 31);
+  __m512 aRe = _mm512_loadu_ps(h0.re + i);
+  __m512 aIm = _mm512_loadu_ps(h0.im + i);
+  __m512 mRe = _mm512_loadu_ps(h0.mirrorRe + i);
+  __m512 mIm = _mm512_loadu_ps(h0.mirrorIm + i);
+
+  __m512 re = _mm512_fmsub_ps(_mm512_add_ps(aRe, mRe), c,
+                              _mm512_mul_ps(_mm512_sub_ps(aIm, mIm), s));
+  __m512 im = _mm512_fmadd_ps(_mm512_sub_ps(aRe, mRe), s,
+                              _mm512_mul_ps(_mm512_add_ps(aIm, mIm), c));
+
+  _mm512_storeu_ps(out + 2 * i, _mm512_permutex2var_ps(re, loIdx, im));
+  _mm512_storeu_ps(out + 2 * i + 16, _mm512_permutex2var_ps(re, hiIdx, im));
+}
+
+void evolveSpectrumAVX512(const PairedSpectrumRun &h0, const float *w,
+                          int count, float t, std::complex<float> *out) {
+  float *o = reinterpret_cast<float *>(out);
+  const __m512 time = _mm512_set1_ps(t);
+
+  int i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m512 s, c;
+    sincos512(_mm512_mul_ps(_mm512_loadu_ps(w + i), time), &s, &c);
+    combine(h0, i, c, s, o);
+  }
+
+  if (i < count) {
+    PairedSpectrumRun tail = {h0.re + i, h0.im + i, h0.mirrorRe + i,
+                              h0.mirrorIm + i};
+    evolveSpectrumScalar(tail, w + i, count - i, t, out + i);
+  }
+}
+
+void evolveSpectrumRotorAVX512(const PairedSpectrumRun &h0,
+                               const float *rotorRe, const float *rotorIm,
+                               float *phaseRe, float *phaseIm, int count,
+                               std::complex<float> *out) {
+  float *o = reinterpret_cast<float *>(out);
+
+  int i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m512 rRe = _mm512_loadu_ps(rotorRe + i);
+    __m512 rIm = _mm512_loadu_ps(rotorIm + i);
+    __m512 pRe = _mm512_loadu_ps(phaseRe + i);
+    __m512 pIm = _mm512_loadu_ps(phaseIm + i);
+
+    // p *= r
+    __m512 c = _mm512_fmsub_ps(pRe, rRe, _mm512_mul_ps(pIm, rIm));
+    __m512 s = _mm512_fmadd_ps(pRe, rIm, _mm512_mul_ps(pIm, rRe));
+    _mm512_storeu_ps(phaseRe + i, c);
+    _mm512_storeu_ps(phaseIm + i, s);
+
+    combine(h0, i, c, s, o);
+  }
+
+  if (i < count) {
+    PairedSpectrumRun tail = {h0.re + i, h0.im + i, h0.mirrorRe + i,
+                              h0.mirrorIm + i};
+    evolveSpectrumRotorScalar(tail, rotorRe + i, rotorIm + i, phaseRe + i,
+                              phaseIm + i, count - i, out + i);
+  }
+}
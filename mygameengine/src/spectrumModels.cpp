@@ -0,0 +1,128 @@
+#include "spectrumModels.h"
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include "philox.h"
+
+using namespace std;
+
+SpectrumConstants makeSpectrumConstants(const SpectrumParams &params, float g,
+                                        float patchSize) {
+  const float pi = 3.14159265358979f;
+  SpectrumConstants c = {};
+  c.g = g;
+  c.windX = std::cos(params.windDirection);
+  c.windY = std::sin(params.windDirection);
+  float dk = 2.0f * pi / patchSize;
+  c.binArea = dk * dk;
+
+  c.amplitude = params.amplitude;
+  float largestWave = params.windSpeed * params.windSpeed / g;
+  c.largestWave2 = largestWave * largestWave;
+
+  float U = params.windSpeed;
+  if (params.model == SPECTRUM_PIERSON_MOSKOWITZ) {
+    c.alpha = 8.1e-3f;
+    c.peakOmega = 0.855f * g / U;
+    c.logGamma = 0.0f;
+  } else {
+    // JONSWAP fit to fetch F (Hasselmann et al. 1973)
+    float F = params.fetch;
+    c.alpha = 0.076f * std::pow(U * U / (F * g), 0.22f);
+    c.peakOmega = 22.0f * std::cbrt(g * g / (U * F));
+    c.logGamma = std::log(params.peakEnhancement);
+  }
+  c.depthFactor = std::sqrt(params.depth / g);
+
+  // integral of cos^2s(theta / 2) over [-pi, pi] is
+  // 2 sqrt(pi) Gamma(s + 1/2) / Gamma(s + 1)
+  float s = params.spreading;
+  c.spreading = s;
+  c.spreadingNorm = std::exp(std::lgamma(s + 1.0f) - std::lgamma(s + 0.5f)) /
+                    (2.0f * std::sqrt(pi));
+  return c;
+}
+
+SpectrumRowFn spectrumRowKernel(SpectrumModel model) {
+  static const SpectrumRowFn kernels[SPECTRUM_MODEL_COUNT] = {
+      evaluateSpectrumRow<PhillipsSpectrum>,
+      evaluateSpectrumRow<PiersonMoskowitzSpectrum>,
+      evaluateSpectrumRow<JonswapSpectrum>,
+      evaluateSpectrumRow<TmaSpectrum>,
+  };
+  return kernels[model];
+}
+
+const char *spectrumModelName(SpectrumModel model) {
+  static const char *names[SPECTRUM_MODEL_COUNT] = {
+      "Phillips", "Pierson-Moskowitz", "JONSWAP", "TMA"};
+  return names[model];
+}
+
+void benchmarkSpectrumModels(int n, float patchSize) {
+  const int repeats = 10;
+  vector<float> kx(n), out(n);
+  for (int j = 0; j < n; ++j) {
+    kx[j] = 2.0f * 3.14159265358979f * (j - n / 2) / patchSize;
+  }
+
+  float checksum = 0.0f;
+  for (int model = 0; model < SPECTRUM_MODEL_COUNT; ++model) {
+    SpectrumParams params;
+    params.model = SpectrumModel(model);
+    SpectrumConstants c = makeSpectrumConstants(params, 9.81f, patchSize);
+    SpectrumRowFn row = spectrumRowKernel(params.model);
+
+    auto start = chrono::steady_clock::now();
+    for (int r = 0; r < repeats; ++r) {
+      for (int i = 0; i < n; ++i) {
+        float ky = 2.0f * 3.14159265358979f * (i - n / 2) / patchSize;
+        row(c, kx.data(), ky, n, out.data());
+        checksum += out[n / 3];
+      }
+    }
+    double seconds =
+        chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << spectrumModelName(params.model) << " spectrum: "
+         << seconds * 1000.0 / repeats << " ms per " << n << "x" << n
+         << " grid (" << seconds * 1e9 / (double(repeats) * n * n)
+         << " ns per bin)" << endl;
+  }
+  // keeps the evaluations from being optimized away
+  if (checksum < 0.0f) cout << checksum << endl;
+}
+
+void generateSpectrumRows(const SpectrumGrid &grid, int rowBegin, int rowEnd,
+                          complex<float> *out) {
+  const float pi = 3.14159265358979f;
+  const int n = grid.n;
+  const float L = grid.patchSize;
+  // constants of the model are derived once, then whole rows are evaluated
+  // by the model's specialized row kernel
+  const SpectrumConstants constants =
+      makeSpectrumConstants(grid.params, grid.gravity, L);
+  const SpectrumRowFn evaluateRow = spectrumRowKernel(grid.params.model);
+  vector<float> kx(n), P(n);
+  for (int j = 0; j < n; ++j) kx[j] = 2.0f * pi * float(j - n / 2) / L;
+
+  for (int i = rowBegin; i < rowEnd; ++i) {
+    float ky = 2.0f * pi * float(i - n / 2) / L;
+    evaluateRow(constants, kx.data(), ky, n, P.data());
+    complex<float> *row = out + size_t(i - rowBegin) * n;
+    for (int j = 0; j < n; ++j) {
+      // keep only this ocean's band of wavenumbers (cascades split the
+      // spectrum between them)
+      float k = std::sqrt(kx[j] * kx[j] + ky * ky);
+      float amplitude =
+          k < grid.params.minWavenumber || k >= grid.params.maxWavenumber
+              ? 0.0f
+              : std::sqrt(P[j] * 0.5f);
+
+      float gaussReal, gaussImag;
+      philoxGaussian2(grid.seed, uint64_t(i) * n + j, &gaussReal, &gaussImag);
+      row[j] = complex<float>(gaussReal * amplitude, gaussImag * amplitude);
+    }
+  }
+}
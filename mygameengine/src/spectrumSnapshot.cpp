@@ -0,0 +1,85 @@
+#include "spectrumSnapshot.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+
+static bool sameParameters(const SpectrumSnapshotHeader &a,
+                           const SpectrumSnapshotHeader &b) {
+  return a.n == b.n && a.patchSize == b.patchSize &&
+         a.gravity == b.gravity && a.seed == b.seed && a.model == b.model &&
+         a.amplitude == b.amplitude && a.windSpeed == b.windSpeed &&
+         a.windDirection == b.windDirection && a.fetch == b.fetch &&
+         a.peakEnhancement == b.peakEnhancement && a.depth == b.depth &&
+         a.spreading == b.spreading && a.minWavenumber == b.minWavenumber &&
+         a.maxWavenumber == b.maxWavenumber;
+}
+
+SpectrumSnapshotHeader makeSpectrumSnapshotHeader(const SpectrumGrid &grid) {
+  SpectrumSnapshotHeader header = {};
+  header.n = grid.n;
+  header.patchSize = grid.patchSize;
+  header.gravity = grid.gravity;
+  header.seed = grid.seed;
+  header.model = grid.params.model;
+  header.amplitude = grid.params.amplitude;
+  header.windSpeed = grid.params.windSpeed;
+  header.windDirection = grid.params.windDirection;
+  header.fetch = grid.params.fetch;
+  header.peakEnhancement = grid.params.peakEnhancement;
+  header.depth = grid.params.depth;
+  header.spreading = grid.params.spreading;
+  header.minWavenumber = grid.params.minWavenumber;
+  header.maxWavenumber = grid.params.maxWavenumber;
+  return header;
+}
+
+bool SpectrumSnapshot::isValid(const SpectrumSnapshotHeader &stored,
+                               const SpectrumSnapshotHeader &expected,
+                               size_t fileSize) {
+  return fileSize >= sizeof(SpectrumSnapshotHeader) &&
+         memcmp(stored.magic, SPECTRUM_SNAPSHOT_MAGIC, 4) == 0 &&
+         stored.version == SPECTRUM_SNAPSHOT_VERSION &&
+         sameParameters(stored, expected) &&
+         fileSize == sizeof(SpectrumSnapshotHeader) +
+                         size_t(stored.n) * stored.n * sizeof(complex<float>);
+}
+
+bool SpectrumSnapshot::write(const char *path,
+                             const SpectrumSnapshotHeader &params,
+                             const complex<float> *h0) {
+  SpectrumSnapshotHeader header = params;
+  memcpy(header.magic, SPECTRUM_SNAPSHOT_MAGIC, 4);
+  header.version = SPECTRUM_SNAPSHOT_VERSION;
+
+  ofstream out(path, ios::binary);
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char *>(h0),
+            size_t(header.n) * header.n * sizeof(complex<float>));
+  out.close();
+  if (!out) {
+    cerr << "Failed to write spectrum snapshot " << path << endl;
+    return false;
+  }
+  cout << "Saved spectrum snapshot " << path << endl;
+  return true;
+}
+
+bool SpectrumSnapshot::open(const char *path,
+                            const SpectrumSnapshotHeader &expected) {
+  if (!file.open(path)) return false;
+
+  const SpectrumSnapshotHeader *header =
+      static_cast<const SpectrumSnapshotHeader *>(file.data());
+  bool valid = file.size() >= sizeof(SpectrumSnapshotHeader) &&
+               isValid(*header, expected, file.size());
+  if (!valid) {
+    cout << "Spectrum snapshot " << path << " is stale, regenerating" << endl;
+    file.close();
+    return false;
+  }
+  cout << "Loaded spectrum snapshot " << path << endl;
+  return true;
+}
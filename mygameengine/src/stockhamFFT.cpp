@@ -0,0 +1,290 @@
+#include "stockhamFFT.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+constexpr double TWO_PI = 6.283185307179586476925286766559;
+
+// std::sin and std::cos are not constexpr; Taylor series on [0, pi/2) are
+// good to double precision with this many terms
+constexpr double taylorSin(double x) {
+  double term = x, sum = x;
+  for (int i = 1; i < 14; ++i) {
+    term *= -x * x / ((2 * i) * (2 * i + 1));
+    sum += term;
+  }
+  return sum;
+}
+
+constexpr double taylorCos(double x) {
+  double term = 1.0, sum = 1.0;
+  for (int i = 1; i < 14; ++i) {
+    term *= -x * x / ((2 * i - 1) * (2 * i));
+    sum += term;
+  }
+  return sum;
+}
+
+// W^k = exp(+2 pi i k / N), the roots of unity of the backward transform
+template <int N>
+struct Twiddles {
+  float re[N] = {};
+  float im[N] = {};
+
+  constexpr Twiddles() {
+    for (int k = 0; k < N; ++k) {
+      // angle within the quadrant, then rotated by quadrant * 90 degrees
+      int quadrant = 4 * k / N;
+      double a = TWO_PI * (k - quadrant * (N / 4)) / N;
+      double c = taylorCos(a), s = taylorSin(a);
+      const double r[4] = {c, -s, -c, s};
+      const double i[4] = {s, c, -s, -c};
+      re[k] = float(r[quadrant]);
+      im[k] = float(i[quadrant]);
+    }
+  }
+};
+
+constexpr int log2Of(int n) { return n <= 1 ? 0 : 1 + log2Of(n / 2); }
+
+// Per thread scratch for the lane blocks, grown to the largest size once
+float *laneScratch(size_t floats) {
+  static thread_local vector<float> scratch;
+  if (scratch.size() < floats) scratch.resize(floats);
+  return scratch.data();
+}
+
+const int LANES = STOCKHAM_LANES;
+
+template <int N>
+struct Stockham {
+  static constexpr Twiddles<N> twiddles{};
+  // radix-4 stages, then one radix-2 stage if log2(N) is odd
+  static constexpr int STAGES = log2Of(N) / 2 + log2Of(N) % 2;
+  // the stages ping-pong between two buffers; this one ends up with the result
+  static constexpr bool RESULT_IN_SCRATCH = STAGES % 2 == 1;
+
+  // Radix-4 stage over sequences of length n, s floats apart (the lanes
+  // included): reads x[q + s (p + k n/4)], writes y[q + s (4 p + k)]
+  template <int n, int s>
+  static void radix4(const float *__restrict xr, const float *__restrict xi,
+                     float *__restrict yr, float *__restrict yi) {
+    constexpr int m = n / 4;
+    constexpr int step = N / n;  // twiddle index of W_n^1
+    for (int p = 0; p < m; ++p) {
+      const float w1r = twiddles.re[p * step], w1i = twiddles.im[p * step];
+      const float w2r = twiddles.re[2 * p * step];
+      const float w2i = twiddles.im[2 * p * step];
+      const float w3r = twiddles.re[3 * p * step];
+      const float w3i = twiddles.im[3 * p * step];
+      const float *ar = xr + s * p, *ai = xi + s * p;
+      const float *br = ar + s * m, *bi = ai + s * m;
+      const float *cr = br + s * m, *ci = bi + s * m;
+      const float *dr = cr + s * m, *di = ci + s * m;
+      float *y0r = yr + s * 4 * p, *y0i = yi + s * 4 * p;
+      float *y1r = y0r + s, *y1i = y0i + s;
+      float *y2r = y1r + s, *y2i = y1i + s;
+      float *y3r = y2r + s, *y3i = y2i + s;
+
+      for (int q = 0; q < s; ++q) {
+        float apcR = ar[q] + cr[q], apcI = ai[q] + ci[q];
+        float amcR = ar[q] - cr[q], amcI = ai[q] - ci[q];
+        float bpdR = br[q] + dr[q], bpdI = bi[q] + di[q];
+        // i (b - d), +i for the backward transform
+        float jR = di[q] - bi[q], jI = br[q] - dr[q];
+
+        y0r[q] = apcR + bpdR;
+        y0i[q] = apcI + bpdI;
+        float t1R = amcR + jR, t1I = amcI + jI;
+        y1r[q] = w1r * t1R - w1i * t1I;
+        y1i[q] = w1r * t1I + w1i * t1R;
+        float t2R = apcR - bpdR, t2I = apcI - bpdI;
+        y2r[q] = w2r * t2R - w2i * t2I;
+        y2i[q] = w2r * t2I + w2i * t2R;
+        float t3R = amcR - jR, t3I = amcI - jI;
+        y3r[q] = w3r * t3R - w3i * t3I;
+        y3i[q] = w3r * t3I + w3i * t3R;
+      }
+    }
+  }
+
+  // Last stage for odd powers of two, n = 2 needs no twiddles
+  template <int s>
+  static void radix2(const float *__restrict xr, const float *__restrict xi,
+                     float *__restrict yr, float *__restrict yi) {
+    for (int q = 0; q < s; ++q) {
+      yr[q] = xr[q] + xr[q + s];
+      yi[q] = xi[q] + xi[q + s];
+      yr[q + s] = xr[q] - xr[q + s];
+      yi[q + s] = xi[q] - xi[q + s];
+    }
+  }
+
+  template <int n, int s>
+  static void stages(float *xr, float *xi, float *yr, float *yi) {
+    if constexpr (n >= 4) {
+      radix4<n, s>(xr, xi, yr, yi);
+      stages<n / 4, s * 4>(yr, yi, xr, xi);
+    } else if constexpr (n == 2) {
+      radix2<s>(xr, xi, yr, yi);
+    }
+  }
+
+  // LANES transforms at once, element k of lane l at k * LANES + l. The
+  // result is in scratch if RESULT_IN_SCRATCH, in re / im otherwise.
+  static void transform(float *re, float *im, float *scratchRe,
+                        float *scratchIm) {
+    stages<N, LANES>(re, im, scratchRe, scratchIm);
+  }
+
+  // Lane block buffers: input (re, im), then the scratch (re, im)
+  struct Block {
+    float *re, *im, *scratchRe, *scratchIm;
+    const float *resultRe() const { return RESULT_IN_SCRATCH ? scratchRe : re; }
+    const float *resultIm() const { return RESULT_IN_SCRATCH ? scratchIm : im; }
+  };
+  static Block block() {
+    float *base = laneScratch(4 * N * LANES);
+    return {base, base + N * LANES, base + 2 * N * LANES,
+            base + 3 * N * LANES};
+  }
+
+  static void columns(fftwf_complex *spectrum, int width, int begin,
+                      int end) {
+    Block b = block();
+    for (int j0 = begin; j0 < end; j0 += LANES) {
+      const int lanes = std::min(LANES, end - j0);
+
+      // every row holds the lanes as neighbouring bins, one cache line each
+      for (int k = 0; k < N; ++k) {
+        const fftwf_complex *src = spectrum + k * width + j0;
+        float *re = b.re + k * LANES, *im = b.im + k * LANES;
+        for (int l = 0; l < LANES; ++l) {
+          re[l] = l < lanes ? src[l][0] : 0.0f;
+          im[l] = l < lanes ? src[l][1] : 0.0f;
+        }
+      }
+
+      transform(b.re, b.im, b.scratchRe, b.scratchIm);
+
+      const float *re = b.resultRe(), *im = b.resultIm();
+      for (int k = 0; k < N; ++k) {
+        fftwf_complex *dst = spectrum + k * width + j0;
+        for (int l = 0; l < lanes; ++l) {
+          dst[l][0] = re[k * LANES + l];
+          dst[l][1] = im[k * LANES + l];
+        }
+      }
+    }
+  }
+
+  // Transposes rows [i0, i0 + lanes) of `width` bins into a lane block,
+  // LANES x LANES tiles at a time so the reads and writes of a tile stay
+  // within a few cache lines
+  static void gatherRows(const fftwf_complex *spectrum, int width, int i0,
+                         int lanes, const Block &b) {
+    for (int k0 = 0; k0 < N; k0 += LANES) {
+      for (int l = 0; l < LANES; ++l) {
+        const fftwf_complex *src = spectrum + (i0 + l) * width + k0;
+        for (int kk = 0; kk < LANES; ++kk) {
+          b.re[(k0 + kk) * LANES + l] = l < lanes ? src[kk][0] : 0.0f;
+          b.im[(k0 + kk) * LANES + l] = l < lanes ? src[kk][1] : 0.0f;
+        }
+      }
+    }
+  }
+
+  static void rows(const fftwf_complex *spectrum, fftwf_complex *out,
+                   int begin, int end) {
+    Block b = block();
+    for (int i0 = begin; i0 < end; i0 += LANES) {
+      const int lanes = std::min(LANES, end - i0);
+      gatherRows(spectrum, N, i0, lanes, b);
+
+      transform(b.re, b.im, b.scratchRe, b.scratchIm);
+
+      const float *re = b.resultRe(), *im = b.resultIm();
+      for (int k0 = 0; k0 < N; k0 += LANES) {
+        for (int l = 0; l < lanes; ++l) {
+          fftwf_complex *dst = out + (i0 + l) * N + k0;
+          for (int kk = 0; kk < LANES; ++kk) {
+            dst[kk][0] = re[(k0 + kk) * LANES + l];
+            dst[kk][1] = im[(k0 + kk) * LANES + l];
+          }
+        }
+      }
+    }
+  }
+
+  // Real output through a half size complex transform: with M = N / 2,
+  // z[m] = x[2m] + i x[2m + 1] is the backward transform of
+  // Z[k] = (X[k] + conj(X[M - k])) + i W^k (X[k] - conj(X[M - k]))
+  static void rowsReal(const fftwf_complex *spectrum, float *out, int begin,
+                       int end) {
+    constexpr int M = N / 2;
+    constexpr int width = M + 1;
+    typedef Stockham<M> Half;
+    typename Half::Block b = Half::block();
+
+    for (int i0 = begin; i0 < end; i0 += LANES) {
+      const int lanes = std::min(LANES, end - i0);
+      for (int k0 = 0; k0 < M; k0 += LANES) {
+        for (int l = 0; l < LANES; ++l) {
+          const fftwf_complex *X = spectrum + (i0 + l) * width;
+          for (int kk = 0; kk < LANES; ++kk) {
+            const int k = k0 + kk;
+            float zR = 0.0f, zI = 0.0f;
+            if (l < lanes) {
+              float aR = X[k][0], aI = X[k][1];
+              float cR = X[M - k][0], cI = -X[M - k][1];
+              // like FFTW's c2r, only the real parts of the DC and Nyquist
+              // bins count
+              if (k == 0) aI = cI = 0.0f;
+              float dR = aR - cR, dI = aI - cI;
+              // W^k (X[k] - conj(X[M - k])), then times i
+              float wR = twiddles.re[k], wI = twiddles.im[k];
+              float tR = wR * dR - wI * dI, tI = wR * dI + wI * dR;
+              zR = aR + cR - tI;
+              zI = aI + cI + tR;
+            }
+            b.re[k * LANES + l] = zR;
+            b.im[k * LANES + l] = zI;
+          }
+        }
+      }
+
+      Half::transform(b.re, b.im, b.scratchRe, b.scratchIm);
+
+      const float *re = b.resultRe(), *im = b.resultIm();
+      for (int l = 0; l < lanes; ++l) {
+        float *dst = out + (i0 + l) * N;
+        for (int m = 0; m < M; ++m) {
+          dst[2 * m] = re[m * LANES + l];
+          dst[2 * m + 1] = im[m * LANES + l];
+        }
+      }
+    }
+  }
+};
+
+template <int N>
+constexpr StockhamPasses passesFor() {
+  return {&Stockham<N>::columns, &Stockham<N>::rows, &Stockham<N>::rowsReal};
+}
+
+}  // namespace
+
+const StockhamPasses *stockhamPasses(int n) {
+  static const StockhamPasses passes[] = {passesFor<64>(), passesFor<128>(),
+                                          passesFor<256>(), passesFor<512>(),
+                                          passesFor<1024>()};
+  for (int i = 0, size = 64; i < 5; ++i, size *= 2) {
+    if (n == size) return &passes[i];
+  }
+  return nullptr;
+}
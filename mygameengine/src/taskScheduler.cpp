@@ -0,0 +1,298 @@
+#include "taskScheduler.h"
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+
+using namespace std;
+
+static unsigned sharedThreadCount = 0;
+
+FrameGraph::Task &FrameGraph::newTask() {
+  if (count == int(tasks.size())) tasks.emplace_back();
+  Task &task = tasks[count++];
+  task.name = "";
+  task.call = Call();
+  task.rangeBegin = task.rangeEnd = 0;
+  task.successors = nullptr;
+  task.dependencies = 0;
+  task.onCaller = false;
+  task.thread = 0;
+  task.start = task.end = 0.0;
+  return task;
+}
+
+void FrameGraph::addEdges(TaskId id, TaskList after) {
+  for (TaskId dependency : after) {
+    if (dependency < 0) continue;
+    Task &before = tasks[dependency];
+    before.successors = new (arena.allocate<Edge>(1))
+        Edge{id, before.successors};
+    ++tasks[id].dependencies;
+  }
+}
+
+TaskId FrameGraph::addTask(const char *name, Call call, TaskList after,
+                           bool onCaller) {
+  TaskId id = TaskId(count);
+  Task &task = newTask();
+  task.name = name;
+  task.call = call;
+  task.onCaller = onCaller;
+  addEdges(id, after);
+  return id;
+}
+
+TaskId FrameGraph::addChunks(const char *name, int begin, int end, int grain,
+                             Call body, TaskList after) {
+  // the chunks share the one closure, each task holds its own range
+  grain = std::max(grain, 1);
+  const TaskId first = TaskId(count);
+  for (int b = begin; b < end; b += grain) {
+    TaskId id = addTask(name, body, after, false);
+    tasks[id].rangeBegin = b;
+    tasks[id].rangeEnd = std::min(b + grain, end);
+  }
+  const TaskId last = TaskId(count);
+
+  // an empty range still gets its join, so callers can always depend on it
+  TaskId join = addTask(name, Call(), first == last ? after : TaskList(),
+                        false);
+  for (TaskId chunk = first; chunk < last; ++chunk) {
+    addEdges(join, {chunk});
+  }
+  return join;
+}
+
+const char *FrameGraph::format(const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  va_list measure;
+  va_copy(measure, args);
+  int length = std::max(vsnprintf(nullptr, 0, fmt, measure), 0);
+  va_end(measure);
+  char *name = arena.allocate<char>(length + 1);
+  vsnprintf(name, length + 1, fmt, args);
+  va_end(args);
+  return name;
+}
+
+void FrameGraph::clear() {
+  count = 0;
+  arena.reset();
+  wallSeconds_ = 0.0;
+}
+
+vector<FrameGraph::TaskTiming> FrameGraph::timings() const {
+  vector<TaskTiming> result;
+  for (int i = 0; i < count; ++i) {
+    const Task &task = tasks[i];
+    if (task.call.invoke) {
+      result.push_back({task.name, task.thread, task.start, task.end});
+    }
+  }
+  return result;
+}
+
+void FrameGraph::report(ostream &out, unsigned threadCount) const {
+  struct Summary {
+    int count = 0;
+    double busy = 0.0;
+    double first = 1e30;
+    double last = 0.0;
+  };
+  // in order of first appearance, so the stages read top to bottom
+  vector<string> order;
+  map<string, Summary> byName;
+  vector<double> threadBusy(threadCount, 0.0);
+  for (int i = 0; i < count; ++i) {
+    const Task &task = tasks[i];
+    if (!task.call.invoke) continue;
+    auto found = byName.find(task.name);
+    if (found == byName.end()) {
+      order.push_back(task.name);
+      found = byName.emplace(task.name, Summary()).first;
+    }
+    Summary &s = found->second;
+    ++s.count;
+    s.busy += task.end - task.start;
+    s.first = std::min(s.first, task.start);
+    s.last = std::max(s.last, task.end);
+    if (task.thread < threadCount) {
+      threadBusy[task.thread] += task.end - task.start;
+    }
+  }
+
+  double busy = 0.0;
+  for (double b : threadBusy) busy += b;
+  const double ms = 1000.0;
+  out << fixed << setprecision(3) << "Frame graph: " << count
+      << " tasks in " << wallSeconds_ * ms << " ms on " << threadCount
+      << " threads, "
+      << (wallSeconds_ > 0.0 ? 100.0 * busy / (wallSeconds_ * threadCount)
+                             : 0.0)
+      << "% busy" << endl;
+  for (const string &name : order) {
+    const Summary &s = byName[name];
+    out << "  " << left << setw(28) << name << right << setw(4) << s.count
+        << " x " << setw(8) << s.busy * ms << " ms, from " << s.first * ms
+        << " to " << s.last * ms << " ms" << endl;
+  }
+  for (unsigned t = 0; t < threadCount; ++t) {
+    out << "  thread " << t << ": " << threadBusy[t] * ms << " ms busy, "
+        << (wallSeconds_ - threadBusy[t]) * ms << " ms idle" << endl;
+  }
+  out << defaultfloat;
+}
+
+TaskScheduler::TaskScheduler(unsigned threadCount) {
+  if (threadCount == 0) threadCount = max(1u, thread::hardware_concurrency());
+
+  for (unsigned i = 0; i < threadCount; ++i) {
+    queues.push_back(make_unique<WorkQueue>());
+  }
+  for (unsigned i = 1; i < threadCount; ++i) {
+    workers.emplace_back(&TaskScheduler::workerLoop, this, i);
+  }
+  cout << "Started task scheduler with " << threadCount << " threads" << endl;
+}
+
+TaskScheduler::~TaskScheduler() {
+  {
+    lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+    ++epoch;
+  }
+  wake.notify_all();
+  for (thread &worker : workers) worker.join();
+}
+
+TaskScheduler &TaskScheduler::shared() {
+  static TaskScheduler scheduler(sharedThreadCount);
+  return scheduler;
+}
+
+void TaskScheduler::setSharedThreadCount(unsigned threadCount) {
+  sharedThreadCount = threadCount;
+}
+
+void TaskScheduler::run(FrameGraph &frame) {
+  if (frame.count == 0) return;
+
+  runStart = chrono::steady_clock::now();
+  graph = &frame;
+  remaining = frame.size();
+  for (int i = 0; i < frame.count; ++i) {
+    frame.tasks[i].pending = frame.tasks[i].dependencies;
+  }
+  for (auto &queue : queues) queue->reset(frame.count);
+  callerQueue.reset(frame.count);
+
+  // spread the roots over all queues so every thread starts right away
+  unsigned next = 0;
+  for (int i = 0; i < frame.count; ++i) {
+    Task &task = frame.tasks[i];
+    if (task.dependencies == 0) push(&task, next++ % size());
+  }
+
+  for (;;) {
+    unsigned seen = epoch;
+    if (Task *task = findTask(0)) {
+      execute(task, 0);
+      continue;
+    }
+    if (remaining == 0) break;
+
+    unique_lock<std::mutex> lock(mutex);
+    wake.wait(lock, [&] { return epoch != seen; });
+  }
+
+  frame.wallSeconds_ =
+      chrono::duration<double>(chrono::steady_clock::now() - runStart).count();
+  graph = nullptr;
+}
+
+void TaskScheduler::WorkQueue::reset(size_t capacity) {
+  // idle threads may still be looking for work
+  lock_guard<std::mutex> lock(mutex);
+  // grows with the largest graph, then stays
+  if (ring.size() < capacity) ring.resize(capacity);
+  head = tail = 0;
+}
+
+void TaskScheduler::push(Task *task, unsigned self) {
+  WorkQueue &queue = task->onCaller ? callerQueue : *queues[self];
+  {
+    lock_guard<std::mutex> lock(queue.mutex);
+    queue.pushBack(task);
+  }
+  {
+    lock_guard<std::mutex> lock(mutex);
+    ++epoch;
+  }
+  wake.notify_all();
+}
+
+TaskScheduler::Task *TaskScheduler::findTask(unsigned self) {
+  if (self == 0) {
+    lock_guard<std::mutex> lock(callerQueue.mutex);
+    if (!callerQueue.empty()) return callerQueue.popFront();
+  }
+
+  // own queue from the back, the most recently unblocked work
+  {
+    WorkQueue &own = *queues[self];
+    lock_guard<std::mutex> lock(own.mutex);
+    if (!own.empty()) return own.popBack();
+  }
+
+  // steal the oldest task of the next thread that has any
+  for (unsigned i = 1; i < size(); ++i) {
+    WorkQueue &victim = *queues[(self + i) % size()];
+    lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.empty()) return victim.popFront();
+  }
+  return nullptr;
+}
+
+void TaskScheduler::execute(Task *task, unsigned self) {
+  auto start = chrono::steady_clock::now();
+  if (task->call.invoke) {
+    task->call.invoke(task->call.closure, task->rangeBegin, task->rangeEnd);
+  }
+  auto end = chrono::steady_clock::now();
+  task->thread = self;
+  task->start = chrono::duration<double>(start - runStart).count();
+  task->end = chrono::duration<double>(end - runStart).count();
+
+  for (FrameGraph::Edge *edge = task->successors; edge; edge = edge->next) {
+    Task &successor = graph->tasks[edge->task];
+    if (--successor.pending == 0) push(&successor, self);
+  }
+
+  if (--remaining == 0) {
+    {
+      lock_guard<std::mutex> lock(mutex);
+      ++epoch;
+    }
+    wake.notify_all();
+  }
+}
+
+void TaskScheduler::workerLoop(unsigned self) {
+  for (;;) {
+    unsigned seen = epoch;
+    if (Task *task = findTask(self)) {
+      execute(task, self);
+      continue;
+    }
+
+    unique_lock<std::mutex> lock(mutex);
+    wake.wait(lock, [&] { return stopping || epoch != seen; });
+    if (stopping) return;
+  }
+}
@@ -0,0 +1,95 @@
+#include "threadPool.h"
+
+#include <algorithm>
+#include <iostream>
+
+using namespace std;
+
+static unsigned sharedThreadCount = 0;
+
+ThreadPool::ThreadPool(unsigned threadCount) {
+  if (threadCount == 0) threadCount = max(1u, thread::hardware_concurrency());
+
+  for (unsigned i = 1; i < threadCount; ++i) {
+    workers.emplace_back(&ThreadPool::workerLoop, this);
+  }
+  cout << "Started thread pool with " << threadCount << " threads" << endl;
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (thread &worker : workers) worker.join();
+}
+
+ThreadPool &ThreadPool::shared() {
+  static ThreadPool pool(sharedThreadCount);
+  return pool;
+}
+
+void ThreadPool::setSharedThreadCount(unsigned threadCount) {
+  sharedThreadCount = threadCount;
+}
+
+void ThreadPool::parallelFor(int begin, int end,
+                             const function<void(int, int)> &fn, int grain) {
+  if (end <= begin) return;
+
+  // A few chunks per thread so uneven rows still balance out
+  int count = end - begin;
+  int chunk = max(grain, (count + int(size()) * 4 - 1) / (int(size()) * 4));
+  if (workers.empty() || chunk >= count) {
+    fn(begin, end);
+    return;
+  }
+
+  lock_guard<std::mutex> jobLock(jobMutex);
+  const function<void(int, int)> offsetBody = [&](int b, int e) {
+    fn(begin + b, begin + e);
+  };
+  {
+    lock_guard<std::mutex> lock(mutex);
+    body = &offsetBody;
+    jobEnd = count;
+    chunkSize = chunk;
+    nextChunk = 0;
+    busyWorkers = unsigned(workers.size());
+    ++generation;
+  }
+  wake.notify_all();
+
+  runChunks();
+
+  // wait for the workers to finish their last chunk
+  unique_lock<std::mutex> lock(mutex);
+  done.wait(lock, [this] { return busyWorkers == 0; });
+  body = nullptr;
+}
+
+void ThreadPool::runChunks() {
+  for (;;) {
+    int b = nextChunk.fetch_add(chunkSize);
+    if (b >= jobEnd) return;
+    (*body)(b, min(b + chunkSize, jobEnd));
+  }
+}
+
+void ThreadPool::workerLoop() {
+  unsigned seen = 0;
+  for (;;) {
+    {
+      unique_lock<std::mutex> lock(mutex);
+      wake.wait(lock, [&] { return stopping || generation != seen; });
+      if (stopping) return;
+      seen = generation;
+    }
+
+    runChunks();
+
+    lock_guard<std::mutex> lock(mutex);
+    if (--busyWorkers == 0) done.notify_one();
+  }
+}
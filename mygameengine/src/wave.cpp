@@ -1,42 +1,291 @@
 #include "wave.h"
+
+#include <algorithm>
+#include <chrono>
+
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb\stb_image_write.h"
 
 using namespace glm;
 using namespace std;
 
-int N = 256;   // Number of (sin) waves
-int L = 1000;  // Patch size
+// FFTW_PATIENT finds a faster plan but takes minutes the first time; either
+// way the result is cached in FFTW_WISDOM_FILE
+const unsigned FFT_PLAN_FLAGS = FFTW_MEASURE;
+
+// In fixed time step mode every phase row is renormalized once per this many
+// steps, a different slice of rows each step
+const int PHASE_RENORMALIZE_INTERVAL = 64;
+
+// Vertical scale of the rendered heights (and the choppy displacement)
+const float HEIGHT_SCALE = 40.0f;
 
-Wave::Wave() {
+// Rows (or spectrum columns) per task of the frame graph
+const int FRAME_TASK_ROWS = 16;
+
+// Largest rendered mesh, in vertices per side; larger simulations are
+// stretched over it as finer textures
+const int MAX_MESH_RESOLUTION = 1024;
+
+// Per thread fp32 rows for the conversions of the half precision mode
+static float *rowScratch(int floats) {
+  static thread_local std::vector<float> scratch;
+  if (int(scratch.size()) < floats) scratch.resize(floats);
+  return scratch.data();
+}
+
+// Nearest supported grid size
+static int checkedSize(int n) {
+  int size = MIN_WAVE_SIZE;
+  while (size < MAX_WAVE_SIZE && size < n) size *= 2;
+  if (size != n) {
+    cerr << "Wave size " << n << " is not a power of two from "
+         << MIN_WAVE_SIZE << " to " << MAX_WAVE_SIZE << ", using " << size
+         << endl;
+  }
+  return size;
+}
+
+Wave::Wave(const WaveConfig &config)
+    : N(checkedSize(config.n)),
+      L(config.patchSize),
+      snapshotPath(config.snapshotPath),
+      spectrum(config.spectrum) {
   // initialize wave parameters
-  A = 4.0f;
   g = 9.81f;
-  v = 10.0f;
-
-  // mesh creation
-  vertices = new glm::vec3[N * N];
-  texCoords = new glm::vec2[N * N];
 
   createSurface();
 
-  h0_k_ = new std::complex<float>[N * N];
-  h_kt_ = new std::complex<float>[N * N];
-  generatePhillipsSpectrum();
-
-  float currentFrame = 0.0f;
-  float lastFrame = 0.0f;
-  float deltaTime = 0.0f;
-  float timeStep = 0.0f;  // This is the 't' value used for ocean simulation
+  evolveSpectrum = selectEvolveSpectrumKernel();
+  evolveSpectrumRotor = selectEvolveSpectrumRotorKernel();
+  packFields = selectPackFieldsKernel();
+  floatToHalfRow = selectFloatToHalfKernel();
+  halfToFloatRow = selectHalfToFloatKernel();
+  createSimulation(config.fftMode);
+  buildDispersionTable();
+  initSpectrum();
 }
 
 Wave::~Wave() {
-  // free memory
-  delete[] h0_k_;
+  stopAsyncSimulation();
+  releaseSimulation();
+  delete loopCache;
+}
+
+void Wave::createSimulation(FFTMode fftMode) {
+  // Plan before generating the spectrum: FFTW_MEASURE overwrites the buffers
+  fft = new OceanFFT(N, CHANNEL_COUNT, fftMode, FFT_PLAN_FLAGS,
+                     ThreadPool::shared().size());
+
+  // std::complex<float> is layout compatible with fftwf_complex, so h(k,t)
+  // and the spectra derived from it are written straight into the FFT input
+  for (int c = 0; c < CHANNEL_COUNT; ++c) {
+    spectrum_[c] = reinterpret_cast<std::complex<float> *>(fft->input(c));
+  }
+  h_kt_ = spectrum_[CHANNEL_HEIGHT];
+  PersistentPool &pool = PersistentPool::shared();
+  fieldStaging_ = pool.allocate<float>(N * N * 6);
+  fields_ = fieldStaging_;
+  heightStore.resize(N);
+  omega_ = pool.allocate<float>(N * fft->spectrumWidth());
+  waveVector_ = pool.allocate<glm::vec2>(N * fft->spectrumWidth());
+  if (fixedTimeStep > 0.0f) {
+    rotor_ = pool.allocate<float>(2 * N * fft->spectrumWidth());
+    phase_ = pool.allocate<float>(2 * N * fft->spectrumWidth());
+  }
+}
+
+void Wave::releaseSimulation() {
+  // h0 must not point into the mapping or storage meanwhile
+  h0_k_ = nullptr;
+  spectrumSnapshot.close();
+  PersistentPool &pool = PersistentPool::shared();
+  float **floatBuffers[] = {&h0Paired_, &omega_, &rotor_, &phase_,
+                            &fieldStaging_};
+  for (float **buffer : floatBuffers) {
+    pool.release(*buffer);
+    *buffer = nullptr;
+  }
+  pool.release(h0Storage_);
+  pool.release(h0Half_);
+  pool.release(waveVector_);
+  h0Storage_ = nullptr;
+  h0Half_ = nullptr;
+  waveVector_ = nullptr;
+  fields_ = nullptr;
+  heightStore.clear();
+  heightTarget_ = nullptr;
+  delete fft;
+  fft = nullptr;
+}
+
+WaveConfig Wave::config() const {
+  WaveConfig config;
+  config.n = N;
+  config.patchSize = L;
+  config.fftMode = fft->mode();
+  config.spectrum = spectrum;
+  config.snapshotPath = snapshotPath;
+  return config;
+}
+
+void Wave::setConfig(const WaveConfig &config) {
+  whileSimulationStopped([&] { applyConfig(config); });
+}
+
+void Wave::applyConfig(const WaveConfig &config) {
+  const int n = checkedSize(config.n);
+  const bool resized = n != N || config.fftMode != fft->mode();
+
+  if (resized) {
+    if (loopCache) {
+      cerr << "Dropping the loop cache, it was baked for " << N << "x" << N
+           << endl;
+      delete loopCache;
+      loopCache = nullptr;
+    }
+    releaseSimulation();
+    // texels get finer as they get more over the same rendered area
+    if (customTexelSize) fieldTexelSize *= float(N) / n;
+    N = n;
+    createSimulation(config.fftMode);
+    // the mesh only changes below MAX_MESH_RESOLUTION
+    createSurface();
+    if (displacementMapTexture) createFieldTextures();
+  }
+
+  L = config.patchSize;
+  spectrum = config.spectrum;
+  snapshotPath = config.snapshotPath;
+  buildDispersionTable();
+  initSpectrum();
+}
+
+void Wave::setResolution(int n) {
+  WaveConfig next = config();
+  next.n = n;
+  setConfig(next);
 }
 
 void Wave::setCamera(Camera *camera) { this->camera = camera; }
 
+void Wave::setGravity(float gravity) {
+  whileSimulationStopped([&] {
+    g = gravity;
+    buildDispersionTable();
+    // the spectra scale their amplitudes with g, and g keys the snapshot
+    initSpectrum();
+  });
+}
+
+void Wave::setDispersion(const DispersionParams &params) {
+  whileSimulationStopped([&] {
+    dispersion = params;
+    buildDispersionTable();
+  });
+}
+
+void Wave::setLoopPeriod(float T) {
+  whileSimulationStopped([&] {
+    loopPeriod = T;
+    buildDispersionTable();
+  });
+}
+
+void Wave::setHalfPrecision(bool enabled) {
+  if (enabled && loopCache) {
+    cerr << "Loop caches store fp32 fields, keeping fp32" << endl;
+    return;
+  }
+  if (enabled == halfPrecision) return;
+  whileSimulationStopped([&] {
+    halfPrecision = enabled;
+    if (halfPrecision) {
+      storeHalfSpectrum();
+    } else {
+      // back to fp32 planes from h0, not from the rounded halves
+      buildPairedSpectrum();
+      PersistentPool::shared().release(h0Half_);
+      h0Half_ = nullptr;
+    }
+  });
+}
+
+bool Wave::bakeLoop(const char *path, int frames) {
+  if (halfPrecision) {
+    cerr << "Loop caches store fp32 fields, disable half precision" << endl;
+    return false;
+  }
+  if (loopPeriod <= 0.0f) {
+    cerr << "Baking a loop needs a loop period" << endl;
+    return false;
+  }
+  bool baked = false;
+  whileSimulationStopped([&] {
+    // every frame is evaluated at its exact time, whatever the time step
+    // mode
+    float savedTimeStep = fixedTimeStep;
+    fixedTimeStep = 0.0f;
+    baked = LoopCache::bake(path, N, frames, loopPeriod, [&](double t) {
+      generateH_KT_Spectrum(t);
+      generateHeightField();
+      return static_cast<const float *>(fields_);
+    });
+    fixedTimeStep = savedTimeStep;
+  });
+  return baked;
+}
+
+bool Wave::loadLoop(const char *path) {
+  if (halfPrecision) {
+    cerr << "Loop caches store fp32 fields, disable half precision" << endl;
+    return false;
+  }
+  LoopCache *cache = new LoopCache();
+  if (!cache->open(path, N)) {
+    delete cache;
+    return false;
+  }
+  whileSimulationStopped([&] {
+    delete loopCache;
+    loopCache = cache;
+  });
+  return true;
+}
+
+void Wave::setFixedTimeStep(float dt) {
+  whileSimulationStopped([&] {
+    fixedTimeStep = dt;
+    PersistentPool &pool = PersistentPool::shared();
+    pool.release(rotor_);
+    pool.release(phase_);
+    rotor_ = nullptr;
+    phase_ = nullptr;
+
+    if (fixedTimeStep > 0.0f) {
+      rotor_ = pool.allocate<float>(2 * N * fft->spectrumWidth());
+      phase_ = pool.allocate<float>(2 * N * fft->spectrumWidth());
+      buildRotors();
+    }
+  });
+}
+
+// Rotors e^(i w dt) and the current phases e^(i w t), evaluated in double so
+// they start out exact even after hours of simulated time
+void Wave::buildRotors() {
+  const double twoPi = 2.0 * glm::pi<double>();
+  const int bins = N * fft->spectrumWidth();
+  for (int i = 0; i < bins; ++i) {
+    double w = omega_[i];
+    double rotorAngle = w * fixedTimeStep;
+    double phaseAngle = std::fmod(w * timeStep, twoPi);
+    rotor_[i] = float(std::cos(rotorAngle));
+    rotor_[bins + i] = float(std::sin(rotorAngle));
+    phase_[i] = float(std::cos(phaseAngle));
+    phase_[bins + i] = float(std::sin(phaseAngle));
+  }
+}
+
 void Wave::setShader(Shader *shader) {
   this->shader = shader;
   initRenderParams();
@@ -48,219 +297,604 @@ void Wave::initRenderParams() {
   glGenBuffers(1, &EBO);       // Generate EBO
   glGenBuffers(1, &texVBO);    // Generate VBO for texture coordinates
 
+  uploadSurface();
+
   // Bind VAO
   glBindVertexArray(VAO);
 
-  // Bind VBO and send vertex data to GPU
-  glBindBuffer(GL_ARRAY_BUFFER, VBO);
-  glBufferData(GL_ARRAY_BUFFER, N * N * sizeof(glm::vec3), vertices,
-               GL_STATIC_DRAW);
-
-  // Bind EBO and send index data to GPU
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int),
-               indices.data(), GL_STATIC_DRAW);
-
   // Specify vertex attributes (position attribute)
+  glBindBuffer(GL_ARRAY_BUFFER, VBO);
   glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void *)0);
   glEnableVertexAttribArray(0);
 
-  glBindBuffer(GL_ARRAY_BUFFER, texVBO);
-  glBufferData(GL_ARRAY_BUFFER, N * N * sizeof(glm::vec2), texCoords,
-               GL_STATIC_DRAW);
-
   // Specify the texture coordinates attribute (location 1 in shader)
+  glBindBuffer(GL_ARRAY_BUFFER, texVBO);
   glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (void *)0);
   glEnableVertexAttribArray(1);
 
   // Unbind the VAO (safe practice)
   glBindVertexArray(0);
+
+  createFieldTextures();
 }
 
-void Wave::createSurface() {
-  const int planeSize = 1000;
-  const int shift = planeSize / 2;
+// Sends the mesh to its buffers, again whenever createSurface rebuilt it
+void Wave::uploadSurface() {
+  glBindVertexArray(VAO);
 
-  float step = planeSize / (N - 1);
-  // Create vertices
-  for (int z = 0; z < N; ++z) {
-    for (int x = 0; x < N; ++x) {
-      vertices[z * N + x] = vec3(x * step - shift, 0.0f, z * step - shift);
-    }
+  glBindBuffer(GL_ARRAY_BUFFER, VBO);
+  glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3),
+               vertices.data(), GL_STATIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, texVBO);
+  glBufferData(GL_ARRAY_BUFFER, texCoords.size() * sizeof(glm::vec2),
+               texCoords.data(), GL_STATIC_DRAW);
+  // the element buffer binding is part of the VAO
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int),
+               indices.data(), GL_STATIC_DRAW);
+
+  glBindVertexArray(0);
+}
+
+void Wave::createFieldTextures() {
+  // Displacement and slope maps are allocated once per resolution (with
+  // their mip chain) and refilled every frame by generateHeightField
+  if (displacementMapTexture) {
+    GLuint old[2] = {displacementMapTexture, slopeMapTexture};
+    glDeleteTextures(2, old);
+  }
+  int mipLevels = 1;
+  while ((N >> mipLevels) > 0) ++mipLevels;
+
+  GLuint *maps[2] = {&displacementMapTexture, &slopeMapTexture};
+  const GLenum formats[2] = {halfPrecision ? GL_RGBA16F : GL_RGBA32F,
+                             halfPrecision ? GL_RG16F : GL_RG32F};
+  for (int i = 0; i < 2; ++i) {
+    glGenTextures(1, maps[i]);
+    glBindTexture(GL_TEXTURE_2D, *maps[i]);
+    glTexStorage2D(GL_TEXTURE_2D, mipLevels, formats[i], N, N);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
   }
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void Wave::createSurface() {
+  const float planeSize = 1000.0f;
+  const float shift = planeSize / 2;
+
+  // the fields are stretched over the whole mesh: texture coordinates 0 to
+  // 1 with GL_REPEAT, so N texels planeSize / N apart
+  if (!customTexelSize) fieldTexelSize = planeSize / N;
+
+  const int M = std::min(N, MAX_MESH_RESOLUTION);
+  if (M == meshResolution) return;
+  meshResolution = M;
+
+  float step = planeSize / (M - 1);
+  gridStep = step;
 
   // Create indices
-  for (int z = 0; z < N - 1; ++z) {
-    for (int x = 0; x < N - 1; ++x) {
+  indices.clear();
+  indices.reserve(size_t(M - 1) * (M - 1) * 6);
+  for (int z = 0; z < M - 1; ++z) {
+    for (int x = 0; x < M - 1; ++x) {
       // Indices for the first triangle of the quad
-      indices.push_back(z * N + x);        // top-left
-      indices.push_back((z + 1) * N + x);  // bottom-left
-      indices.push_back(z * N + (x + 1));  // top-right
+      indices.push_back(z * M + x);        // top-left
+      indices.push_back((z + 1) * M + x);  // bottom-left
+      indices.push_back(z * M + (x + 1));  // top-right
 
       // Indices for the second triangle of the quad
-      indices.push_back((z + 1) * N + x);        // bottom-left
-      indices.push_back((z + 1) * N + (x + 1));  // bottom-right
-      indices.push_back(z * N + (x + 1));        // top-right
+      indices.push_back((z + 1) * M + x);        // bottom-left
+      indices.push_back((z + 1) * M + (x + 1));  // bottom-right
+      indices.push_back(z * M + (x + 1));        // top-right
     }
   }
 
-  float texStep = 1.0f / (N - 1);  // Step size for texture coordinates
-  for (int z = 0; z < N; ++z) {
-    for (int x = 0; x < N; ++x) {
-      vertices[z * N + x] = vec3(x * step - shift, 0.0f, z * step - shift);
-      texCoords[z * N + x] =
+  // Create vertices
+  vertices.resize(M * M);
+  texCoords.resize(M * M);
+  float texStep = 1.0f / (M - 1);  // Step size for texture coordinates
+  for (int z = 0; z < M; ++z) {
+    for (int x = 0; x < M; ++x) {
+      vertices[z * M + x] = vec3(x * step - shift, 0.0f, z * step - shift);
+      texCoords[z * M + x] =
           vec2(x * texStep, z * texStep);  // Set texture coordinates
     }
   }
+
+  if (VAO) uploadSurface();
+}
+
+void Wave::initSpectrum() {
+  const SpectrumSnapshotHeader params =
+      makeSpectrumSnapshotHeader({N, L, g, seed, spectrum});
+
+  // the mapping is replaced either way, h0 must not point into it meanwhile
+  h0_k_ = nullptr;
+  spectrumSnapshot.close();
+  if (spectrumSnapshot.open(snapshotPath.c_str(), params)) {
+    h0_k_ = spectrumSnapshot.h0();
+    PersistentPool::shared().release(h0Storage_);
+    h0Storage_ = nullptr;
+  } else {
+    generateSpectrum();
+    SpectrumSnapshot::write(snapshotPath.c_str(), params, h0_k_);
+  }
+  buildPairedSpectrum();
+  if (halfPrecision) storeHalfSpectrum();
 }
 
-float Wave::Phillips(glm::vec2 K) {
-  glm::vec2 windDir = vec2(1.0f, 1.0f);
+void Wave::buildPairedSpectrum() {
+  // Only the bins the FFT consumes: the full centered N x N grid, or
+  // N x (N/2 + 1) bins in FFTW order. h0_k_ is stored centered, so K = (n, m)
+  // sits at ((m + N/2) % N, (n + N/2) % N); n = -N/2 and n = N/2 alias
+  // column 0, likewise for the rows.
+  const bool halfSpectrum = fft->mode() == FFT_HALF_COMPLEX;
+  const int width = fft->spectrumWidth();
+  const int plane = N * width;
+  if (!h0Paired_) {
+    h0Paired_ = PersistentPool::shared().allocate<float>(4 * plane);
+  }
 
-  float waveMagnitude = length(K);  // since K is our wave vector
+  ThreadPool::shared().parallelFor(0, N, [&](int rowBegin, int rowEnd) {
+    for (int i = rowBegin; i < rowEnd; ++i) {
+      int m = halfSpectrum ? (i <= N / 2 ? i : i - N) : i - N / 2;
+      const std::complex<float> *h0Row = h0_k_ + ((m + N / 2) % N) * N;
+      const std::complex<float> *h0MirrorRow = h0_k_ + ((N / 2 - m) % N) * N;
+      for (int j = 0; j < width; ++j) {
+        int n = halfSpectrum ? j : j - N / 2;
+        std::complex<float> h0 = h0Row[(n + N / 2) % N];
+        std::complex<float> mirror = std::conj(h0MirrorRow[(N / 2 - n) % N]);
+        const int bin = i * width + j;
+        h0Paired_[bin] = h0.real();
+        h0Paired_[plane + bin] = h0.imag();
+        h0Paired_[2 * plane + bin] = mirror.real();
+        h0Paired_[3 * plane + bin] = mirror.imag();
+      }
+    }
+  });
+}
 
-  if (waveMagnitude < 0.0001f) return 0.0f;
-  float L = v * v / g;
-  return float(
-      A * float(std::exp(-1.0f / std::pow(waveMagnitude * L, 2))) /
-      std::pow(waveMagnitude, 4) *
-      std::pow(glm::dot(glm::normalize(windDir), glm::normalize(K)), 8));
+void Wave::storeHalfSpectrum() {
+  const int plane = N * fft->spectrumWidth();
+  if (!h0Half_) {
+    h0Half_ = PersistentPool::shared().allocate<uint16_t>(4 * plane);
+  }
+  ThreadPool::shared().parallelFor(0, 4, [&](int planeBegin, int planeEnd) {
+    floatToHalfRow(h0Paired_ + planeBegin * plane,
+                   (planeEnd - planeBegin) * plane,
+                   h0Half_ + planeBegin * plane);
+  });
+  // only the halves stay resident, buildPairedSpectrum() remakes the
+  // planes from h0_k_ when needed
+  PersistentPool::shared().release(h0Paired_);
+  h0Paired_ = nullptr;
 }
 
-void Wave::generatePhillipsSpectrum() {
-  cout << "Generating Phillips Spectrum" << endl;
-  std::random_device rd;
-  std::mt19937 gen(rd());
-  std::normal_distribution<float> distribution(0.0f, 1.0f);
+void Wave::generateSpectrum() {
+  cout << "Generating " << spectrumModelName(spectrum.model) << " Spectrum"
+       << endl;
+  if (!h0Storage_) {
+    h0Storage_ = PersistentPool::shared().allocate<std::complex<float>>(N * N);
+  }
+  h0_k_ = h0Storage_;
+
+  // rows are independent, split them across the worker pool
+  const SpectrumGrid grid = {N, L, g, seed, spectrum};
+  ThreadPool::shared().parallelFor(0, N, [&](int rowBegin, int rowEnd) {
+    generateSpectrumRows(grid, rowBegin, rowEnd, h0Storage_ + rowBegin * N);
+  });
+
+  cout << "Generated " << spectrumModelName(spectrum.model) << " Spectrum"
+       << endl;
+  saveAsImage(2.0f);  // Call save with a brightness scale factor
+}
+
+// K and w(k) only depend on the bin, the patch size and the dispersion model,
+// so they are computed once here instead of every frame
+void Wave::buildDispersionTable() {
+  const bool halfSpectrum = fft->mode() == FFT_HALF_COMPLEX;
+  const int width = fft->spectrumWidth();
 
   for (int i = 0; i < N; ++i) {
-    for (int j = 0; j < N; ++j) {
-      float n = float(j - N / 2);
-      float m = float(i - N / 2);
+    for (int j = 0; j < width; ++j) {
+      // same bin layout as h_kt_
+      int n = halfSpectrum ? j : j - N / 2;
+      int m = halfSpectrum ? (i <= N / 2 ? i : i - N) : i - N / 2;
 
+      // physical wave vector K = 2 pi (n, m) / L
       glm::vec2 K = glm::vec2(2.0f * glm::pi<float>() * n / L,
                               2.0f * glm::pi<float>() * m / L);
-      float guass_real = distribution(gen);
-      float guass_img = distribution(gen);
-
-      float P = std::sqrt(Phillips(K) * 0.5f);
-      h0_k_[i * N + j] = std::complex<float>(guass_real * P, guass_img * P);
+      waveVector_[i * width + j] = K;
+      // in looping mode every bin completes a whole number of cycles in T
+      omega_[i * width + j] =
+          loopOmega(dispersionOmega(dispersion, g, length(K)), loopPeriod);
     }
   }
 
-  cout << "Generated Phillips Spectrum" << endl;
-  saveAsImage(2.0f);  // Call save with a brightness scale factor
+  if (fixedTimeStep > 0.0f) buildRotors();
 }
 
 // Should be computed on the GPU
-void Wave::generateH_KT_Spectrum(float t) {
-  // Generate h_kt from h0_k_
-  for (int i = 0; i < N; ++i) {
-    for (int j = 0; j < N; ++j) {
-      // Calculate wave vector K and -K
-      glm::vec2 K_indices =
-          glm::vec2(j - N / 2, i - N / 2);  // Original indices
-      glm::vec2 minus_K_indices =
-          glm::vec2(N - 1 - j, N - 1 - i);  // Indices for -K
-
-      // Get h0(K) and h0(-K)
-      std::complex<float> h0_K = h0_k_[i * N + j];  // Get h0(K)
-      std::complex<float> h0_minusK =
-          h0_k_[(int(minus_K_indices.y)) * N +
-                int(minus_K_indices.x)];  // Get h0(-K)
-
-      // Calculate the angular frequency w(k) (dispersion relation)
-      float w_k = std::sqrt(
-          9.81 *
-          length(K_indices));  // Example: w(k) = sqrt(g * |k|), g = 9.81 m/s�
-
-      // Calculate the time-dependent Fourier amplitudes
-      std::complex<float> exp_iwt =
-          std::exp(std::complex<float>(0, w_k * t));  // e^(i * w(k) * t)
-      std::complex<float> exp_neg_iwt =
-          std::exp(std::complex<float>(0, -w_k * t));  // e^(-i * w(k) * t)
-
-      // Compute h_kt_ at this K
-      h_kt_[i * N + j] = h0_K * exp_iwt + std::conj(h0_minusK) * exp_neg_iwt;
-    }
-  }
+void Wave::generateH_KT_Spectrum(double t) {
+  // rows are independent, split them across the worker pool
+  ThreadPool::shared().parallelFor(0, N, [&](int rowBegin, int rowEnd) {
+    evolveRows(t, rowBegin, rowEnd);
+  });
   // saveAsImage(2.0f, 1);  // Call save with a brightness scale factor
 }
 
-// Function to perform the 2D Inverse FFT and generate the height field
-void Wave::generateHeightField() {
-  // Create arrays to store the spatial domain height field
-  fftwf_complex *h_kt_complex =
-      fftwf_alloc_complex(N * N);  // FFTW input (frequency domain)
-  fftwf_complex *height_field =
-      fftwf_alloc_complex(N * N);  // FFTW output (spatial domain)
+void Wave::evolveRows(double t, int rowBegin, int rowEnd) {
+  // Generate h_kt from the paired spectrum, which holds h0(K) and
+  // conj(h0(-K)) in the bin order of h_kt_: every row is one forward run
+  // through the four planes.
+  const int width = fft->spectrumWidth();
+  const int plane = N * width;
+  const bool rotorMode = fixedTimeStep > 0.0f;
+  // each step renormalizes a different slice of the phase rows
+  const int renormalizeSlice = int(stepCount % PHASE_RENORMALIZE_INTERVAL);
+  // The row of m = -N/2 also stands for m = N/2, so a derivative along z
+  // has no conjugate partner there: the real part of the c2c transform
+  // cancels it, the c2r transform would not, so it is dropped in both
+  const int nyquistRow = fft->mode() == FFT_HALF_COMPLEX ? N / 2 : 0;
+
+  for (int i = rowBegin; i < rowEnd; ++i) {
+    const int row = i * width;
+    PairedSpectrumRun h0;
+    if (h0Half_) {
+      // load path of the fp16 mode: the row of every plane widened into
+      // L1-resident scratch, the kernels below run unchanged
+      float *rows = rowScratch(4 * width);
+      for (int p = 0; p < 4; ++p) {
+        halfToFloatRow(h0Half_ + p * plane + row, width, rows + p * width);
+      }
+      h0 = {rows, rows + width, rows + 2 * width, rows + 3 * width};
+    } else {
+      h0 = {h0Paired_ + row, h0Paired_ + plane + row,
+            h0Paired_ + 2 * plane + row, h0Paired_ + 3 * plane + row};
+    }
 
-  // Copy h_kt_ (frequency domain) data to h_kt_complex
-  for (int i = 0; i < N; ++i) {
-    for (int j = 0; j < N; ++j) {
-      h_kt_complex[i * N + j][0] = h_kt_[i * N + j].real();  // Real part
-      h_kt_complex[i * N + j][1] = h_kt_[i * N + j].imag();  // Imaginary part
+    if (rotorMode) {
+      float *phaseRe = phase_ + row, *phaseIm = phase_ + plane + row;
+      if (i % PHASE_RENORMALIZE_INTERVAL == renormalizeSlice) {
+        renormalizePhases(phaseRe, phaseIm, width);
+      }
+      evolveSpectrumRotor(h0, rotor_ + row, rotor_ + plane + row, phaseRe,
+                          phaseIm, width, h_kt_ + row);
+    } else {
+      evolveSpectrum(h0, omega_ + row, width, float(t), h_kt_ + row);
+    }
+
+    // Derived spectra: choppy displacement D(K, t) = -i K / |K| h(K, t)
+    // and the exact slope grad h = i K h(K, t)
+    const float zDerivative = i == nyquistRow ? 0.0f : 1.0f;
+    for (int j = row; j < row + width; ++j) {
+      std::complex<float> h = h_kt_[j];
+      glm::vec2 K = waveVector_[j];
+      float k = length(K);
+      glm::vec2 dir = k > 0.0f ? K / k : glm::vec2(0.0f);
+      K.y *= zDerivative;
+      dir.y *= zDerivative;
+      spectrum_[CHANNEL_DISPLACEMENT_X][j] =
+          std::complex<float>(dir.x * h.imag(), -dir.x * h.real());
+      spectrum_[CHANNEL_DISPLACEMENT_Z][j] =
+          std::complex<float>(dir.y * h.imag(), -dir.y * h.real());
+      spectrum_[CHANNEL_SLOPE_X][j] =
+          std::complex<float>(-K.x * h.imag(), K.x * h.real());
+      spectrum_[CHANNEL_SLOPE_Z][j] =
+          std::complex<float>(-K.y * h.imag(), K.y * h.real());
     }
   }
+}
 
-  // Create an FFTW plan to compute the 2D IFFT
-  fftwf_plan ifft_plan = fftwf_plan_dft_2d(N, N, h_kt_complex, height_field,
-                                           FFTW_BACKWARD, FFTW_ESTIMATE);
+// Function to perform the 2D Inverse FFT and generate the height field
+void Wave::generateHeightField() {
+  // The spectra already live in the FFT input buffer; one batched plan made in
+  // the constructor transforms height, displacements and slopes together
+  fft->execute();
+
+  // One fused pass normalizes (scaling after FFTW IFFT), undoes the
+  // checkerboard sign of the centered spectrum, derives the Jacobian and
+  // packs everything into the staging buffer
+  ThreadPool::shared().parallelFor(0, N, [&](int rowBegin, int rowEnd) {
+    packRows(rowBegin, rowEnd);
+  });
+}
 
-  // Execute the IFFT
-  fftwf_execute(ifft_plan);
+void Wave::packRows(int rowBegin, int rowEnd) {
+  const int stride = fft->outputStride();
+  const bool centered = fft->mode() == FFT_COMPLEX;
+  float *displacement = fields_;
+  float *slope = fields_ + N * N * 4;
+  uint16_t *halfDisplacement = reinterpret_cast<uint16_t *>(fields_);
+  uint16_t *halfSlope = halfDisplacement + N * N * 4;
+  // store path of the fp16 mode: rows are packed in fp32 scratch, then
+  // narrowed into the staging buffer
+  float *scratch = halfPrecision ? rowScratch(6 * N) : nullptr;
+  const float N2 = float(N * N);
+
+  PackFieldsRow row;
+  row.n = N;
+  row.stride = stride;
+  // the vertex shader moves vertices by -choppiness * HEIGHT_SCALE * D,
+  // and neighbouring texels are fieldTexelSize apart
+  row.jacobianScale = -choppiness * HEIGHT_SCALE / (2.0f * fieldTexelSize);
+
+  for (int z = rowBegin; z < rowEnd; ++z) {
+    auto channelRow = [&](int channel, int r) {
+      return fft->outputReal(channel) + ((r + N) % N) * N * stride;
+    };
+    row.height = channelRow(CHANNEL_HEIGHT, z);
+    row.displacementX = channelRow(CHANNEL_DISPLACEMENT_X, z);
+    row.displacementZ = channelRow(CHANNEL_DISPLACEMENT_Z, z);
+    row.slopeX = channelRow(CHANNEL_SLOPE_X, z);
+    row.slopeZ = channelRow(CHANNEL_SLOPE_Z, z);
+    row.displacementXUp = channelRow(CHANNEL_DISPLACEMENT_X, z - 1);
+    row.displacementXDown = channelRow(CHANNEL_DISPLACEMENT_X, z + 1);
+    row.displacementZUp = channelRow(CHANNEL_DISPLACEMENT_Z, z - 1);
+    row.displacementZDown = channelRow(CHANNEL_DISPLACEMENT_Z, z + 1);
+
+    // sign correction for the centered spectrum, which flips the sign of
+    // the output in a checkerboard pattern
+    float evenSign = (centered && (z & 1)) ? -1.0f : 1.0f;
+    float oddSign = centered ? -evenSign : evenSign;
+    row.scale[0] = evenSign / N2;
+    row.scale[1] = oddSign / N2;
+
+    if (halfPrecision) {
+      row.displacement = scratch;
+      row.slope = scratch + N * 4;
+      packFields(row);
+      floatToHalfRow(scratch, N * 4, halfDisplacement + z * N * 4);
+      floatToHalfRow(scratch + N * 4, N * 2, halfSlope + z * N * 2);
+    } else {
+      row.displacement = displacement + z * N * 4;
+      row.slope = slope + z * N * 2;
+      packFields(row);
+    }
 
-  // Normalize the result (scaling after FFTW IFFT)
-  float N2 = N * N;
-  float *real_part = new float[N2];  // Real part of the height field
-  for (int i = 0; i < N2; ++i) {
-    // height_field[i][0] /= (N2);  // Normalize real part
-    // height_field[i][1] /= (N2);  // Normalize imaginary part (though it
-    // should be very small)
-    real_part[i] = height_field[i][0] / (N2);  // Store the real part
+    if (heightTarget_) {
+      // fp32 heights of the packed row (before any narrowing), scaled as
+      // the renderer scales them
+      float *heights = heightTarget_ + z * N;
+      for (int x = 0; x < N; ++x) {
+        heights[x] = row.displacement[x * 4 + 1] * HEIGHT_SCALE;
+      }
+    }
   }
+}
 
-  // Free the FFTW plan and input/output arrays
-  fftwf_destroy_plan(ifft_plan);
-  fftwf_free(h_kt_complex);
+void Wave::storeHeightRows(int rowBegin, int rowEnd) {
+  if (!heightTarget_) return;
+  const float *displacement = fields_;
+  for (int i = rowBegin * N; i < rowEnd * N; ++i) {
+    heightTarget_[i] = displacement[i * 4 + 1] * HEIGHT_SCALE;
+  }
+}
 
-  // Save the height field as an image
-  // saveHeightFieldAsImage(height_field);
+void Wave::publishHeights() {
+  if (!heightTarget_) return;
+  heightTarget_ = nullptr;
+  float texelsPerUnit, offset;
+  heightTexelMapping(&texelsPerUnit, &offset);
+  heightStore.publish(texelsPerUnit, offset);
+}
 
-  // Free the height field
-  fftwf_free(height_field);
+void Wave::heightTexelMapping(float *texelsPerUnit, float *offset) const {
+  // this mesh spans N texels of fieldTexelSize centered on the origin,
+  // cascades repeat the field every N texels from the origin
+  *texelsPerUnit = 1.0f / fieldTexelSize;
+  *offset = customTexelSize ? -0.5f : 0.5f * N - 0.5f;
+}
 
-  glGenTextures(1, &heightMapTexture);
-  glBindTexture(GL_TEXTURE_2D, heightMapTexture);
+SparseOcean Wave::createSparseOcean(int bins) const {
+  // texel u sits at u L / N metres of the patch
+  float texelsPerUnit, offset;
+  heightTexelMapping(&texelsPerUnit, &offset);
+  SparseOceanParams params;
+  params.bins = bins;
+  params.gravity = g;
+  params.dispersion = dispersion;
+  params.loopPeriod = loopPeriod;
+  params.metresPerUnit = texelsPerUnit * L / N;
+  params.originMetres = offset * L / N;
+  params.heightScale = HEIGHT_SCALE;
+  return SparseOcean(h0_k_, N, L, params);
+}
 
-  // Set texture parameters
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+// Refills the textures allocated in initRenderParams from a staging buffer
+void Wave::uploadFields(const void *fields) {
+  const GLenum type = fieldType();
+  const size_t valueSize = halfPrecision ? sizeof(uint16_t) : sizeof(float);
+  const char *displacement = static_cast<const char *>(fields);
+  const char *slope = displacement + size_t(N) * N * 4 * valueSize;
 
-  // Upload the height field data (use real_part array as the source of height
-  // data)
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, N, N, 0, GL_RED, GL_FLOAT, real_part);
+  glBindTexture(GL_TEXTURE_2D, displacementMapTexture);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, N, N, GL_RGBA, type, displacement);
+  glGenerateMipmap(GL_TEXTURE_2D);
 
-  // Generate mipmaps for better scaling
+  // The slopes go next to the displacement, the vertex shader builds the
+  // normals from them without sampling neighbouring texels
+  glBindTexture(GL_TEXTURE_2D, slopeMapTexture);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, N, N, GL_RG, type, slope);
   glGenerateMipmap(GL_TEXTURE_2D);
 
   // Unbind the texture
   glBindTexture(GL_TEXTURE_2D, 0);
 }
 
-void Wave::update() {
-  currentFrame = static_cast<float>(glfwGetTime());
+void Wave::simulate(double t) {
+  heightTarget_ = heightStore.beginFrame();
+  if (loopCache) {
+    // baked loop: blend two cached frames, no spectrum or FFT work
+    loopCache->sample(t, fields_);
+    if (heightTarget_) {
+      ThreadPool::shared().parallelFor(0, N, [&](int rowBegin, int rowEnd) {
+        storeHeightRows(rowBegin, rowEnd);
+      });
+    }
+  } else {
+    // update wave
+    // Take h0_k_ and generate time dependent component, h_kt
+    generateH_KT_Spectrum(t);
+    generateHeightField();
+  }
+  publishHeights();
+}
+
+void Wave::simulateTimed(ThreadPool &pool, double t, double seconds[3]) {
+  heightTarget_ = heightStore.beginFrame();
+  const int width = fft->spectrumWidth();
+  auto start = chrono::steady_clock::now();
+  auto lap = [&](int pass) {
+    auto now = chrono::steady_clock::now();
+    seconds[pass] += chrono::duration<double>(now - start).count();
+    start = now;
+  };
+
+  pool.parallelFor(0, N, [&](int b, int e) { evolveRows(t, b, e); });
+  lap(0);
+  pool.parallelFor(0, width, [&](int b, int e) { fft->executeColumns(b, e); },
+                   FRAME_TASK_ROWS);
+  pool.parallelFor(0, N, [&](int b, int e) { fft->executeRows(b, e); },
+                   FRAME_TASK_ROWS);
+  lap(1);
+  pool.parallelFor(0, N, [&](int b, int e) { packRows(b, e); });
+  lap(2);
+  publishHeights();
+}
+
+TaskId Wave::addSimulationTasks(FrameGraph &graph, double t,
+                                TaskList after, const char *label) {
+  // The height slot is claimed when the tasks run, not when the graph is
+  // built: one graph may hold several updates of this Wave (a cascade
+  // catching up), each writing and publishing its own frame
+  TaskId begin = graph.add(
+      graph.format("%sbegin heights", label),
+      [this] { heightTarget_ = heightStore.beginFrame(); }, after);
+  auto publish = [&](TaskId done) {
+    return graph.add(graph.format("%spublish heights", label),
+                     [this] { publishHeights(); }, {done});
+  };
+  if (loopCache) {
+    TaskId sampled =
+        graph.add(graph.format("%sloop sample", label),
+                  [this, t] { loopCache->sample(t, fields_); }, {begin});
+    return publish(graph.addParallel(
+        graph.format("%sheights", label), 0, N, FRAME_TASK_ROWS,
+        [this](int b, int e) { storeHeightRows(b, e); }, {sampled}));
+  }
+
+  // Every pass reads all of the previous one (columns span every row, the
+  // Jacobian reads neighbouring rows), so the passes chain through joins;
+  // the chunks in between are free to run on any core
+  const int width = fft->spectrumWidth();
+  TaskId evolved = graph.addParallel(
+      graph.format("%sevolve", label), 0, N, FRAME_TASK_ROWS,
+      [this, t](int b, int e) { evolveRows(t, b, e); }, {begin});
+  TaskId columns = graph.addParallel(
+      graph.format("%sfft columns", label), 0, width, FRAME_TASK_ROWS,
+      [this](int b, int e) { fft->executeColumns(b, e); }, {evolved});
+  TaskId rows = graph.addParallel(
+      graph.format("%sfft rows", label), 0, N, FRAME_TASK_ROWS,
+      [this](int b, int e) { fft->executeRows(b, e); }, {columns});
+  TaskId packed = graph.addParallel(
+      graph.format("%spack", label), 0, N, FRAME_TASK_ROWS,
+      [this](int b, int e) { packRows(b, e); }, {rows});
+  return publish(packed);
+}
+
+void Wave::scheduleFrame(FrameGraph &graph) {
+  advanceClock();
+  TaskId simulated = addSimulationTasks(graph, timeStep);
+  graph.addOnCaller("upload", [this] { uploadFields(fields_); },
+                    {simulated});
+}
+
+void Wave::advanceClock() {
+  currentFrame = glfwGetTime();
   deltaTime = currentFrame - lastFrame;
-  timeStep += deltaTime;
-  // update wave
-  // Take h0_k_ and generate time dependent component, h_kt
-  generateH_KT_Spectrum(timeStep);
-  generateHeightField();
+  if (fixedTimeStep > 0.0f) {
+    // one fixed step per frame, phases advance by their rotors
+    timeStep += fixedTimeStep;
+    ++stepCount;
+  } else {
+    timeStep += deltaTime;
+  }
+  lastFrame = currentFrame;
+}
+
+void Wave::update() {
+  if (handoff) {
+    // pick up the latest completed frame, if any, without waiting
+    if (handoff->acquire()) {
+      uploadFields(handoff->frontBuffer());
+      pacing.notify_one();
+    }
+    render();
+    return;
+  }
+
+  advanceClock();
+  simulate(timeStep);
+  uploadFields(fields_);
   render();
   // cout << "Updated Wave" << endl;
-  lastFrame = currentFrame;
+}
+
+void Wave::startAsyncSimulation() {
+  if (handoff) return;
+
+  for (float *&staging : asyncStaging_) {
+    staging = PersistentPool::shared().allocate<float>(N * N * 6);
+  }
+  handoff = new TripleBuffer<float>(fieldStaging_, asyncStaging_[0],
+                                    asyncStaging_[1]);
+
+  // one frame up front so the first update() has something to show
+  advanceClock();
+  fields_ = handoff->backBuffer();
+  simulate(timeStep);
+  handoff->publish();
+
+  simulationRunning = true;
+  simulationThread = std::thread(&Wave::simulationLoop, this);
+}
+
+void Wave::stopAsyncSimulation() {
+  if (!handoff) return;
+
+  simulationRunning = false;
+  pacing.notify_one();
+  simulationThread.join();
+
+  // the frames in flight are dropped; back to simulating in update()
+  delete handoff;
+  handoff = nullptr;
+  for (float *&staging : asyncStaging_) {
+    PersistentPool::shared().release(staging);
+    staging = nullptr;
+  }
+  fields_ = fieldStaging_;
+}
+
+void Wave::simulationLoop() {
+  while (simulationRunning) {
+    advanceClock();
+    fields_ = handoff->backBuffer();
+    simulate(timeStep);
+    handoff->publish();
+
+    // Frames the renderer never picks up are wasted work, so wait until it
+    // took this one. The timeout covers a notify that raced the check.
+    std::unique_lock<std::mutex> lock(pacingMutex);
+    while (simulationRunning && handoff->hasFresh()) {
+      pacing.wait_for(lock, std::chrono::milliseconds(1));
+    }
+  }
 }
 
 void Wave::render() {
@@ -269,15 +903,25 @@ void Wave::render() {
   // Bind the VAO (this also binds the VBO and EBO stored in the VAO)
   glBindVertexArray(VAO);
 
-  // Bind the height map texture
+  // Bind the displacement map texture
   glActiveTexture(GL_TEXTURE0);  // Activate texture unit 0
   glBindTexture(GL_TEXTURE_2D,
-                heightMapTexture);  // Bind the height map texture
-  glUniform1i(glGetUniformLocation(shader->ID, "heightMap"),
+                displacementMapTexture);  // Bind the displacement map texture
+  glUniform1i(glGetUniformLocation(shader->ID, "displacementMap"),
               0);  // Pass texture to shader
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_2D, slopeMapTexture);
+  glUniform1i(glGetUniformLocation(shader->ID, "slopeMap"), 1);
 
   // Set the height scale uniform (controls how much the vertices are displaced)
-  glUniform1f(glGetUniformLocation(shader->ID, "heightScale"), 40.0f);
+  glUniform1f(glGetUniformLocation(shader->ID, "heightScale"), HEIGHT_SCALE);
+  // Horizontal displacement relative to the vertical one
+  glUniform1f(glGetUniformLocation(shader->ID, "choppiness"), choppiness);
+  // The slopes are per meter of the L sized patch, which is stretched over
+  // (meshResolution - 1) * gridStep world units; heights are scaled by
+  // heightScale
+  glUniform1f(glGetUniformLocation(shader->ID, "slopeScale"),
+              HEIGHT_SCALE * L / ((meshResolution - 1) * gridStep));
 
   // pass view and projection matrices to the shader
   glm::mat4 model = glm::mat4(1.0f);
@@ -314,8 +958,9 @@ void Wave::render() {
 
 void Wave::saveAsImage(float brightnessScale, int option) {
   // Prepare arrays to hold real and imaginary parts for normalization
-  float *realPart = new float[N * N];
-  float *imagPart = new float[N * N];
+  imageScratch.reset();
+  float *realPart = imageScratch.allocate<float>(N * N);
+  float *imagPart = imageScratch.allocate<float>(N * N);
 
   for (int i = 0; i < N; ++i) {
     for (int j = 0; j < N; ++j) {
@@ -331,7 +976,7 @@ void Wave::saveAsImage(float brightnessScale, int option) {
   float realMax = *std::max_element(realPart, realPart + N * N);
   float realMin = *std::min_element(realPart, realPart + N * N);
   unsigned char *image_data =
-      new unsigned char[N * N * 3];  // 3 channels: R, G, B
+      imageScratch.allocate<unsigned char>(N * N * 3);  // R, G, B
 
   for (int i = 0; i < N * N; ++i) {
     // Apply brightness scale to the real and imaginary parts
@@ -359,11 +1004,6 @@ void Wave::saveAsImage(float brightnessScale, int option) {
                              : "results/phillips_spectrum_time.png",
                  N, N, 3, image_data, N * 3);
 
-  // Free the allocated memory
-  delete[] image_data;
-  delete[] realPart;
-  delete[] imagPart;
-
   if (option == 0) {
     cout << "Saved Phillips Spectrum" << endl;
   } else {
@@ -371,16 +1011,10 @@ void Wave::saveAsImage(float brightnessScale, int option) {
   }
 }
 
-void Wave::saveHeightFieldAsImage(fftwf_complex *height_field) {
-  // Allocate memory for a single-channel grayscale image
-  unsigned char *image_data = new unsigned char[N * N];  // For grayscale image
-  float *real_part = new float[N * N];
-
-  // Extract the real part from the height field (height should be real)
-  for (int i = 0; i < N * N; ++i) {
-    real_part[i] =
-        height_field[i][0];  // Use only the real part for the heightfield
-  }
+void Wave::saveHeightFieldAsImage(const float *real_part) {
+  // Single-channel grayscale image
+  imageScratch.reset();
+  unsigned char *image_data = imageScratch.allocate<unsigned char>(N * N);
 
   // Normalize the real part to [0, 255] for image representation
   float real_max = *std::max_element(real_part, real_part + N * N);
@@ -399,9 +1033,173 @@ void Wave::saveHeightFieldAsImage(fftwf_complex *height_field) {
   // Save the image as a grayscale PNG (1 channel)
   stbi_write_png("results/height_field_grayscale.png", N, N, 1, image_data, N);
 
-  // Free allocated memory
-  delete[] real_part;
-  delete[] image_data;
-
   cout << "Saved height field as a grayscale image." << endl;
 }
+
+void benchmarkThreadScaling() {
+  const int frames = 10;
+  const double frameTime = 1.0 / 60.0;
+  const unsigned maxThreads = std::max(1u, thread::hardware_concurrency());
+  for (int n = 256; n <= 2048; n *= 2) {
+    WaveConfig config;
+    config.n = n;
+    config.snapshotPath = "spectrum_benchmark.ocean";
+    Wave wave(config);
+
+    double single = 0.0;
+    for (unsigned threads = 1; threads <= maxThreads; ++threads) {
+      ThreadPool pool(threads);
+      // warm up, then time whole frames pass by pass
+      double seconds[3] = {};
+      wave.simulateTimed(pool, 0.0, seconds);
+      seconds[0] = seconds[1] = seconds[2] = 0.0;
+      for (int f = 1; f <= frames; ++f) {
+        wave.simulateTimed(pool, f * frameTime, seconds);
+      }
+
+      const double total = seconds[0] + seconds[1] + seconds[2];
+      if (threads == 1) single = total;
+      cout << n << "x" << n << " on " << threads << " threads: evolve "
+           << seconds[0] * 1000.0 / frames << " ms, FFT "
+           << seconds[1] * 1000.0 / frames << " ms, pack "
+           << seconds[2] * 1000.0 / frames << " ms, speedup "
+           << single / total << endl;
+    }
+  }
+}
+
+bool verifyHalfSpectrumFFT(int n, double t) {
+  Wave *waves[2];
+  for (int w = 0; w < 2; ++w) {
+    WaveConfig config;
+    config.n = n;
+    config.fftMode = w == 0 ? FFT_COMPLEX : FFT_HALF_COMPLEX;
+    // the same h0 for both, from one snapshot
+    config.snapshotPath = "spectrum_benchmark.ocean";
+    waves[w] = new Wave(config);
+    waves[w]->simulate(t);
+  }
+
+  // largest difference of each channel relative to the c2c channel's peak
+  const char *names[6] = {"Dx", "height", "Dz", "J", "slope x", "slope z"};
+  float peak[6] = {}, difference[6] = {};
+  const float *full = static_cast<const float *>(waves[0]->fields());
+  const float *half = static_cast<const float *>(waves[1]->fields());
+  const size_t plane = size_t(n) * n * 4;
+  for (size_t i = 0; i < size_t(n) * n * 6; ++i) {
+    int channel = i < plane ? int(i & 3) : 4 + int(i & 1);
+    peak[channel] = std::max(peak[channel], std::abs(full[i]));
+    difference[channel] =
+        std::max(difference[channel], std::abs(half[i] - full[i]));
+  }
+
+  // float rounding of two differently ordered transforms of N^2 terms
+  const float tolerance = 1e-4f;
+  bool matches = true;
+  cout << n << "x" << n << " c2r against c2c at t = " << t
+       << ", largest difference relative to the channel peak:";
+  for (int c = 0; c < 6; ++c) {
+    float relative = difference[c] / std::max(peak[c], 1e-30f);
+    matches = matches && relative <= tolerance;
+    cout << " " << names[c] << " " << relative;
+  }
+  cout << (matches ? "" : " (MISMATCH)") << endl;
+
+  for (Wave *wave : waves) delete wave;
+  return matches;
+}
+
+void benchmarkHalfPrecision(int n) {
+  const int frames = 20;
+  const double frameTime = 1.0 / 60.0;
+  Wave *waves[2];
+  double seconds[2];
+  for (int w = 0; w < 2; ++w) {
+    WaveConfig config;
+    config.n = n;
+    config.snapshotPath = "spectrum_benchmark.ocean";
+    waves[w] = new Wave(config);
+    waves[w]->setHalfPrecision(w == 1);
+    // warm up, then time whole frames of spectrum, FFT and packing
+    waves[w]->simulate(0.0);
+    auto start = chrono::steady_clock::now();
+    for (int f = 1; f <= frames; ++f) waves[w]->simulate(f * frameTime);
+    seconds[w] =
+        chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  }
+
+  // largest error of each channel relative to that channel's peak
+  const char *names[6] = {"Dx", "height", "Dz", "J", "slope x", "slope z"};
+  float peak[6] = {}, error[6] = {};
+  const float *exact = static_cast<const float *>(waves[0]->fields());
+  const uint16_t *half = static_cast<const uint16_t *>(waves[1]->fields());
+  const size_t plane = size_t(n) * n * 4;
+  for (size_t i = 0; i < size_t(n) * n * 6; ++i) {
+    int channel = i < plane ? int(i & 3) : 4 + int(i & 1);
+    float value = exact[i];
+    peak[channel] = std::max(peak[channel], std::abs(value));
+    error[channel] =
+        std::max(error[channel], std::abs(halfToFloat(half[i]) - value));
+  }
+
+  // the paired h0 is four planes over the n x (n/2 + 1) bins the FFT reads,
+  // held as either floats or halves; the staging is written once and
+  // uploaded once
+  const double mb = 1.0 / (1024.0 * 1024.0);
+  const double bins = double(n) * n;
+  const double spectrumBins = double(n) * (n / 2 + 1);
+  cout << n << "x" << n << " fp16 storage: h0 resident and read "
+       << spectrumBins * 16.0 * mb << " -> " << spectrumBins * 8.0 * mb
+       << " MB, fields written and uploaded "
+       << bins * 6 * 4 * 2 * mb << " -> " << bins * 6 * 2 * 2 * mb
+       << " MB per frame; " << seconds[0] * 1000.0 / frames << " -> "
+       << seconds[1] * 1000.0 / frames << " ms per frame" << endl;
+  cout << "  largest fp16 error relative to the channel peak:";
+  for (int c = 0; c < 6; ++c) {
+    cout << " " << names[c] << " " << error[c] / std::max(peak[c], 1e-30f);
+  }
+  cout << endl;
+
+  for (Wave *wave : waves) delete wave;
+}
+
+void benchmarkSparseOcean(int n) {
+  const double t = 12.5;
+  WaveConfig config;
+  config.n = n;
+  config.snapshotPath = "spectrum_benchmark.ocean";
+  Wave wave(config);
+  wave.simulate(t);
+  HeightSnapshot snapshot = wave.heightSnapshot();
+  const HeightField &field = snapshot.field();
+
+  // every texel center of the field, where its heights are exact
+  vector<glm::vec2> positions(size_t(n) * n);
+  for (int z = 0; z < n; ++z) {
+    for (int x = 0; x < n; ++x) {
+      positions[z * n + x] = glm::vec2(x - field.offset, z - field.offset) /
+                             field.texelsPerUnit;
+    }
+  }
+  vector<float> heights(positions.size());
+
+  for (int bins = 64; bins <= 4096; bins *= 4) {
+    SparseOcean sparse = wave.createSparseOcean(bins);
+    auto start = chrono::steady_clock::now();
+    sparse.evaluate(positions, t, heights);
+    double seconds =
+        chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    float error = 0.0f, squares = 0.0f;
+    for (size_t i = 0; i < heights.size(); ++i) {
+      float difference = heights[i] - field.heights[i];
+      error = std::max(error, std::abs(difference));
+      squares += difference * difference;
+    }
+    cout << n << "x" << n << " sparse ocean, " << bins << " bins: "
+         << seconds * 1e6 / positions.size() << " us per query, error "
+         << error << " (rms " << std::sqrt(squares / heights.size())
+         << "), bound " << sparse.errorBound() << " (rms "
+         << sparse.rmsError() << ")" << endl;
+  }
+}
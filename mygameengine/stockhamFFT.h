@@ -0,0 +1,36 @@
+#ifndef STOCKHAM_FFT_H
+#define STOCKHAM_FFT_H
+
+#include <fftw3.h>
+
+// In-engine inverse FFT for the power-of-two sizes we ship (64 - 1024), an
+// alternative to FFTW for OceanFFT. Radix-4 Stockham stages (plus one radix-2
+// stage for odd powers of two) on split real / imaginary arrays, with the
+// size a template parameter so twiddles are tables built at compile time and
+// every loop bound is a constant.
+//
+// Transforms run STOCKHAM_LANES at a time, interleaved element by element,
+// so the butterflies are plain loops over lanes the compiler vectorizes.
+// Columns of the spectrum are already laid out like that; rows are brought
+// there by a cache-blocked transpose.
+//
+// Unnormalized backward transforms with FFTW's conventions, so the results
+// match FFTW_BACKWARD and c2r up to rounding.
+
+const int STOCKHAM_LANES = 8;
+
+struct StockhamPasses {
+  // Column pass of one N x width spectrum: columns [begin, end), in place
+  void (*columns)(fftwf_complex *spectrum, int width, int begin, int end);
+  // Row pass of a full N x N spectrum into N x N complex output
+  void (*rows)(const fftwf_complex *spectrum, fftwf_complex *out, int begin,
+               int end);
+  // Row pass of an N x (N/2 + 1) half spectrum into N x N real output
+  void (*rowsReal)(const fftwf_complex *spectrum, float *out, int begin,
+                   int end);
+};
+
+// Passes for an n x n grid, or nullptr if n is not one of the built sizes
+const StockhamPasses *stockhamPasses(int n);
+
+#endif
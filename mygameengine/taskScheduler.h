@@ -0,0 +1,219 @@
+#ifndef TASK_SCHEDULER_H
+#define TASK_SCHEDULER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <ostream>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "frameArena.h"
+
+typedef int TaskId;
+
+// Tasks to wait for, a braced list or a vector; not copied, so only valid
+// during the call it is passed to
+class TaskList {
+ public:
+  TaskList() = default;
+  TaskList(std::initializer_list<TaskId> ids)
+      : begin_(std::data(ids)), end_(begin_ + ids.size()) {}
+  TaskList(const std::vector<TaskId> &ids)
+      : begin_(ids.data()), end_(ids.data() + ids.size()) {}
+
+  const TaskId *begin() const { return begin_; }
+  const TaskId *end() const { return end_; }
+
+ private:
+  const TaskId *begin_ = nullptr;
+  const TaskId *end_ = nullptr;
+};
+
+// One frame of work as a graph of tasks: spectrum evolution, FFT column and
+// row passes, the post pass and the texture uploads of every Wave, each
+// waiting only for what it reads. Independent waves (cascades) interleave, so
+// a core that finished one wave's rows picks up another wave's columns.
+// A graph can be run again; the timings are those of the last run.
+//
+// Built anew every frame without touching the heap: the task records are
+// recycled by clear(), and closures, names and edges live in the graph's
+// FrameArena. Closures are copied there and never destroyed, so they may
+// only capture trivially destructible values. Names are not copied: pass
+// literals or strings from format().
+class FrameGraph {
+ public:
+  // Runs fn once every task in `after` has finished
+  template <class Fn>
+  TaskId add(const char *name, Fn &&fn, TaskList after = {}) {
+    return addTask(name, wrap(std::forward<Fn>(fn)), after, false);
+  }
+  // Calls body(chunkBegin, chunkEnd) over [begin, end) in chunks of `grain`
+  // items, one task each. The returned task finishes after the last chunk.
+  template <class Fn>
+  TaskId addParallel(const char *name, int begin, int end, int grain,
+                     Fn &&body, TaskList after = {}) {
+    return addChunks(name, begin, end, grain, wrap(std::forward<Fn>(body)),
+                     after);
+  }
+  // Like add, but always runs on the thread calling TaskScheduler::run
+  // (anything touching the GL context)
+  template <class Fn>
+  TaskId addOnCaller(const char *name, Fn &&fn, TaskList after = {}) {
+    return addTask(name, wrap(std::forward<Fn>(fn)), after, true);
+  }
+
+  // printf into the graph's arena, for task names; valid until clear()
+  const char *format(const char *fmt, ...);
+
+  void clear();
+  int size() const { return count; }
+
+  // When and where a task ran, in seconds since the run started
+  struct TaskTiming {
+    const char *name;
+    unsigned thread;  // 0 is the calling thread
+    double start;
+    double end;
+  };
+  std::vector<TaskTiming> timings() const;
+  double wallSeconds() const { return wallSeconds_; }
+
+  // Time per task name and how busy every thread was during the last run
+  void report(std::ostream &out, unsigned threadCount) const;
+
+ private:
+  friend class TaskScheduler;
+
+  // Type-erased closure in the arena, called with the task's range
+  struct Call {
+    void (*invoke)(void *closure, int begin, int end) = nullptr;
+    void *closure = nullptr;
+  };
+  struct Edge {
+    TaskId task;
+    Edge *next;
+  };
+
+  struct Task {
+    const char *name = "";
+    Call call;  // empty for the joins of addParallel
+    int rangeBegin = 0;  // chunk of an addParallel body
+    int rangeEnd = 0;
+    Edge *successors = nullptr;
+    int dependencies = 0;
+    bool onCaller = false;
+    std::atomic<int> pending{0};  // unfinished dependencies during a run
+
+    unsigned thread = 0;
+    double start = 0.0;
+    double end = 0.0;
+  };
+  // stable addresses while the graph grows; the first `count` are in use
+  std::deque<Task> tasks;
+  int count = 0;
+  FrameArena arena;
+  double wallSeconds_ = 0.0;
+
+  // Copies fn into the arena; chunk bodies take the task's range
+  template <class Fn>
+  Call wrap(Fn &&fn) {
+    typedef std::decay_t<Fn> Closure;
+    static_assert(std::is_trivially_destructible_v<Closure>,
+                  "frame graph closures are never destroyed");
+    Call call;
+    call.closure =
+        new (arena.allocate<Closure>(1)) Closure(std::forward<Fn>(fn));
+    call.invoke = [](void *closure, int begin, int end) {
+      Closure &f = *static_cast<Closure *>(closure);
+      if constexpr (std::is_invocable_v<Closure &, int, int>) {
+        f(begin, end);
+      } else {
+        f();
+      }
+    };
+    return call;
+  }
+
+  Task &newTask();
+  TaskId addTask(const char *name, Call call, TaskList after, bool onCaller);
+  TaskId addChunks(const char *name, int begin, int end, int grain,
+                   Call body, TaskList after);
+  void addEdges(TaskId id, TaskList after);
+};
+
+// Work-stealing job system. Every thread owns a queue: it pushes the tasks
+// its own work unblocks to the back and pops from the back, which keeps a
+// wave's consecutive passes on warm caches, while idle threads steal the
+// oldest tasks from the front of the others' queues. The calling thread
+// takes part in run(), so a scheduler of size 1 runs everything inline.
+// Tasks must not call run() themselves.
+class TaskScheduler {
+ public:
+  // threadCount includes the calling thread; 0 means one per hardware thread
+  explicit TaskScheduler(unsigned threadCount = 0);
+  ~TaskScheduler();
+
+  unsigned size() const { return unsigned(queues.size()); }
+
+  // Runs every task of the graph and returns once all have finished
+  void run(FrameGraph &graph);
+
+  // Engine-wide scheduler, created on first use with the configured count
+  static TaskScheduler &shared();
+  // Must be called before the first shared() to take effect
+  static void setSharedThreadCount(unsigned threadCount);
+
+ private:
+  typedef FrameGraph::Task Task;
+
+  // Ring of tasks; every task is queued once per run, so run() sizes each
+  // ring to the graph and pushes never allocate
+  struct WorkQueue {
+    std::mutex mutex;
+    std::vector<Task *> ring;
+    size_t head = 0;  // oldest task
+    size_t tail = 0;  // one past the newest
+
+    bool empty() const { return head == tail; }
+    void reset(size_t capacity);
+    void pushBack(Task *task) { ring[tail++ % ring.size()] = task; }
+    Task *popBack() { return ring[--tail % ring.size()]; }
+    Task *popFront() { return ring[head++ % ring.size()]; }
+  };
+  // queues[0] belongs to the calling thread, callerQueue holds the tasks
+  // only it may run
+  std::vector<std::unique_ptr<WorkQueue>> queues;
+  WorkQueue callerQueue;
+  std::vector<std::thread> workers;
+
+  std::mutex mutex;
+  std::condition_variable wake;
+  // bumped whenever a task is queued or the run finishes, so a thread that
+  // found nothing to do knows whether it is worth looking again
+  std::atomic<unsigned> epoch{0};
+  bool stopping = false;
+
+  // current run
+  FrameGraph *graph = nullptr;
+  std::atomic<int> remaining{0};
+  std::chrono::steady_clock::time_point runStart;
+
+  void workerLoop(unsigned self);
+  Task *findTask(unsigned self);
+  void execute(Task *task, unsigned self);
+  void push(Task *task, unsigned self);
+
+  TaskScheduler(const TaskScheduler &) = delete;
+  TaskScheduler &operator=(const TaskScheduler &) = delete;
+};
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads shared by the whole engine. The calling thread
+// takes part in parallelFor, so a pool of size 1 has no workers and runs
+// everything inline.
+class ThreadPool {
+ public:
+  // threadCount includes the calling thread; 0 means one per hardware thread
+  explicit ThreadPool(unsigned threadCount = 0);
+  ~ThreadPool();
+
+  unsigned size() const { return unsigned(workers.size()) + 1; }
+
+  // Calls body(chunkBegin, chunkEnd) over [begin, end) split into chunks of
+  // at least `grain` items, and returns once every chunk has run
+  void parallelFor(int begin, int end,
+                   const std::function<void(int, int)> &body, int grain = 1);
+
+  // Engine-wide pool, created on first use with the configured thread count
+  static ThreadPool &shared();
+  // Must be called before the first shared() to take effect
+  static void setSharedThreadCount(unsigned threadCount);
+
+ private:
+  std::vector<std::thread> workers;
+
+  std::mutex jobMutex;  // serializes parallelFor calls
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable done;
+  bool stopping = false;
+  unsigned generation = 0;  // bumped for every new job
+  unsigned busyWorkers = 0;
+
+  // current job
+  const std::function<void(int, int)> *body = nullptr;
+  int jobEnd = 0;
+  int chunkSize = 1;
+  std::atomic<int> nextChunk{0};
+
+  void workerLoop();
+  void runChunks();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+};
+
+#endif
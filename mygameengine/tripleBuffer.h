@@ -0,0 +1,54 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+
+// Lock-free single producer / single consumer handoff of frames. The
+// producer always has a back buffer to write, the consumer always has a
+// front buffer to read, and the third one sits in the middle holding the
+// latest completed frame. Neither side ever waits for the other; frames the
+// consumer is too slow to pick up are overwritten.
+template <class T>
+class TripleBuffer {
+ public:
+  // takes three buffers, owned by the caller
+  TripleBuffer(T *a, T *b, T *c) : middle(1) {
+    slots[0] = a;
+    slots[1] = b;
+    slots[2] = c;
+  }
+
+  // producer side
+  T *backBuffer() { return slots[back]; }
+  // makes the back buffer the latest frame and takes the old middle one
+  void publish() {
+    back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX;
+  }
+
+  // consumer side
+  const T *frontBuffer() const { return slots[front]; }
+  // true if a frame newer than the front buffer was published
+  bool hasFresh() const {
+    return (middle.load(std::memory_order_acquire) & FRESH) != 0;
+  }
+  // swaps the latest frame into the front buffer; false if there is none
+  bool acquire() {
+    if (!hasFresh()) return false;
+    front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+    return true;
+  }
+
+ private:
+  static const int INDEX = 3;
+  static const int FRESH = 4;  // middle holds a frame not yet acquired
+
+  T *slots[3];
+  int back = 0;   // producer only
+  int front = 2;  // consumer only
+  std::atomic<int> middle;
+
+  TripleBuffer(const TripleBuffer &) = delete;
+  TripleBuffer &operator=(const TripleBuffer &) = delete;
+};
+
+#endif
@@ -8,57 +8,318 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
 #include <glm/gtx/norm.hpp>
+#include <atomic>
+#include <condition_variable>
 #include <iostream>
-#include <random>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 #include <GLFW/glfw3.h>
 
 #include "camera.h"
+#include "dispersion.h"
+#include "frameArena.h"
+#include "fieldKernels.h"
+#include "halfFloat.h"
+#include "heightQuery.h"
+#include "loopCache.h"
+#include "oceanFFT.h"
+#include "philox.h"
 #include "shaderClass.h"
+#include "sparseOcean.h"
+#include "spectrumKernels.h"
+#include "spectrumModels.h"
+#include "spectrumSnapshot.h"
+#include "taskScheduler.h"
+#include "threadPool.h"
+#include "tripleBuffer.h"
+
+// Spectra transformed together every frame
+enum WaveChannel {
+  CHANNEL_HEIGHT,
+  CHANNEL_DISPLACEMENT_X,  // choppy horizontal displacement
+  CHANNEL_DISPLACEMENT_Z,
+  CHANNEL_SLOPE_X,  // dh/dx for the normals
+  CHANNEL_SLOPE_Z,
+  CHANNEL_COUNT,
+};
+
+// Grid resolutions a Wave accepts (powers of two)
+const int MIN_WAVE_SIZE = 64;
+const int MAX_WAVE_SIZE = 4096;
+
+// Size and spectrum of one ocean patch. Every Wave keeps its own, so oceans
+// of different sizes run side by side.
+struct WaveConfig {
+  int n = 256;                // grid resolution, waves per axis
+  float patchSize = 1000.0f;  // metres
+  FFTMode fftMode = FFT_HALF_COMPLEX;
+  SpectrumParams spectrum;
+  std::string snapshotPath = SPECTRUM_SNAPSHOT_FILE;
+};
 
 class Wave
 {
+  int N;    // grid resolution (number of waves per axis)
+  float L;  // patch size, metres
+  std::string snapshotPath;
+
   // wave parameters
-  std::complex<float> *h0_k_;
-  std::complex<float> *h_kt_;
+  const std::complex<float> *h0_k_;  // h0Storage_ or the mapped snapshot
+  std::complex<float> *h0Storage_ = nullptr;
+  // h0(K) and conj(h0(-K)) per bin of h_kt_, as four N x width planes:
+  // Re h0(K), Im h0(K), Re conj(h0(-K)), Im conj(h0(-K)), row by row.
+  // Released in half precision mode once narrowed into h0Half_.
+  float *h0Paired_ = nullptr;
+  // fp16 h0Paired_ in half precision mode, the only copy evolveRows reads
+  uint16_t *h0Half_ = nullptr;
+  SpectrumSnapshot spectrumSnapshot;
+  unsigned seed = 1;  // key of the counter-based gaussian draws in h0
+  std::complex<float> *h_kt_;  // aliases the FFT input buffer
+  std::complex<float> *spectrum_[CHANNEL_COUNT];  // h_kt_ and derived spectra
 
-  float A;
+  OceanFFT *fft;
+  EvolveSpectrumFn evolveSpectrum;  // SIMD width picked for this CPU
+  EvolveSpectrumRotorFn evolveSpectrumRotor;
+  PackFieldsFn packFields;
+  FloatToHalfFn floatToHalfRow;
+  HalfToFloatFn halfToFloatRow;
+
+  // Half precision mode: h0 and the staged fields are stored as fp16
+  bool halfPrecision = false;
+
+  // Persistent staging for the texture uploads, written once per frame by the
+  // post-FFT pass: N x N RGBA (Dx, height, Dz, J), then N x N RG slopes.
+  // Holds fp16 values in half precision mode (see fieldType()).
+  float *fieldStaging_;
+  float *fields_;  // buffer simulate() writes: fieldStaging_ or handoff's back
+
+  // Asynchronous mode: a simulation thread produces frames into a triple
+  // buffer (fieldStaging_ and asyncStaging_), update() uploads the latest one
+  TripleBuffer<float> *handoff = nullptr;
+  float *asyncStaging_[2] = {nullptr, nullptr};
+  std::thread simulationThread;
+  std::atomic<bool> simulationRunning{false};
+  // lets the simulation idle until the renderer took its last frame
+  std::mutex pacingMutex;
+  std::condition_variable pacing;
+
+  DispersionParams dispersion;
+  float *omega_;  // w(k) per bin of h_kt_
+  glm::vec2 *waveVector_;  // K per bin of h_kt_
+
+  SpectrumParams spectrum;
   float g;
-  float v;
+  float choppiness = 1.0f;
+
+  double currentFrame = 0.0;
+  double lastFrame = 0.0;
+  double deltaTime = 0.0;
+  double timeStep = 0.0; // 't' value used for ocean simulation
 
-  float currentFrame = 0.0f;
-  float lastFrame = 0.0f;
-  float deltaTime = 0.0f;
-  float timeStep = 0.0f; // 't' value used for ocean simulation
+  // fixed time step mode (fixedTimeStep > 0): per-bin rotors e^(i w dt)
+  // advance the running phases e^(i w t) by one multiply per step. Both are
+  // a real plane followed by an imaginary plane, N x width each.
+  float fixedTimeStep = 0.0f;
+  unsigned long long stepCount = 0;
+  float *rotor_ = nullptr;
+  float *phase_ = nullptr;
+
+  // looping mode (loopPeriod > 0): every w(k) is a multiple of 2 pi / T, and
+  // a baked loop, once loaded, replaces the spectrum and FFT work
+  float loopPeriod = 0.0f;
+  LoopCache *loopCache = nullptr;
 
   Camera *camera;
   Shader *shader;
 
-  glm::vec3 *vertices;
+  // The mesh has min(N, MAX_MESH_RESOLUTION) vertices per side; finer
+  // fields only add texels
+  int meshResolution = 0;
+  std::vector<glm::vec3> vertices;
   std::vector<unsigned int> indices;
-  glm::vec2 *texCoords;
-  GLuint VAO, VBO, EBO, texVBO;
-  GLuint heightMapTexture;
+  std::vector<glm::vec2> texCoords;
+  GLuint VAO = 0, VBO = 0, EBO = 0, texVBO = 0;
+  float gridStep;  // mesh vertex spacing
+  float fieldTexelSize;  // rendered distance between texels of the fields
+  bool customTexelSize = false;  // set by setFieldTexelSize
+  GLuint displacementMapTexture = 0;
+  GLuint slopeMapTexture = 0;
+  // scratch of the image dumps, reused from one call to the next
+  FrameArena imageScratch;
+
+  // Height channel of the completed frames for sampleHeights, in world
+  // units; the frame being simulated writes heightTarget_ (nullptr when
+  // every spare slot is still being read)
+  HeightFieldStore heightStore;
+  float *heightTarget_ = nullptr;
 
   // wave functions
 
+  // Buffers, tables and FFT plans sized by N and the FFT mode
+  void createSimulation(FFTMode fftMode);
+  void releaseSimulation();
+  // setConfig() once the simulation thread is stopped
+  void applyConfig(const WaveConfig &config);
+  // Runs change() with the simulation thread stopped, since it owns the
+  // spectrum, tables and buffers while it runs, and restarts it after
+  template <class Change>
+  void whileSimulationStopped(Change change) {
+    const bool async = handoff != nullptr;
+    stopAsyncSimulation();
+    change();
+    if (async) startAsyncSimulation();
+  }
+  void createFieldTextures();
+  void uploadSurface();
+  // Copies the heights of fields_ into heightTarget_ (loop caches, whose
+  // frames skip packRows)
+  void storeHeightRows(int rowBegin, int rowEnd);
+  void publishHeights();
+  // Texel coordinate u = position * texelsPerUnit + offset of the
+  // renderer's field lookups
+  void heightTexelMapping(float *texelsPerUnit, float *offset) const;
+
 public:
-  Wave();
+  explicit Wave(const WaveConfig &config = WaveConfig());
   ~Wave();
 
+  WaveConfig config() const;
+  // Applies a new configuration, rebuilding only what it changes: a new
+  // resolution or FFT mode replaces the buffers, plans and textures (and
+  // the mesh if its resolution changes), a new patch size or spectrum only
+  // the dispersion table and h0. Not while a frame graph is running; a
+  // resize waits for the height snapshots of the old size to be released.
+  void setConfig(const WaveConfig &config);
+  void setResolution(int n);
+
   void setCamera(Camera *camera);
   void setShader(Shader *shader);
+  // Rebuilds the dispersion table and h0, whose amplitudes depend on g
+  void setGravity(float gravity);
+  void setDispersion(const DispersionParams &params);
+  // dt > 0 advances the simulation by dt every update() without evaluating
+  // any sin/cos; 0 goes back to following the wall clock
+  void setFixedTimeStep(float dt);
+  void setChoppiness(float lambda) { choppiness = lambda; }
+  // the fields are rendered stretched over this ocean's own mesh unless
+  // another renderer (OceanCascades) says otherwise
+  void setFieldTexelSize(float size) {
+    fieldTexelSize = size;
+    customTexelSize = true;
+  }
+  // take effect on the next initSpectrum()
+  void setSeed(unsigned s) { seed = s; }
+  void setSpectrum(const SpectrumParams &params) { spectrum = params; }
+  // Keeps h0 and the fields in fp16, computing in fp32; halves the memory
+  // traffic of both. Call before setShader, which picks the texture formats.
+  // Not available with loop caches, which store fp32 frames.
+  void setHalfPrecision(bool enabled);
+  // T > 0 snaps every w(k) down to a multiple of 2 pi / T so the ocean
+  // repeats with period T; 0 goes back to the exact dispersion
+  void setLoopPeriod(float T);
+
+  // Bakes `frames` frames of one loop period to path (needs a loop period)
+  bool bakeLoop(const char *path, int frames);
+  // Plays back a baked loop instead of simulating; false if the file is
+  // missing or does not match this ocean
+  bool loadLoop(const char *path);
 
   void initRenderParams();
 
-  float Phillips(glm::vec2 K);
-  void generatePhillipsSpectrum();
-  void generateH_KT_Spectrum(float t);
+  void buildDispersionTable();
+  void buildRotors();
+  void generateSpectrum();
+  // Maps h0 from the snapshot if it was made with the current parameters,
+  // otherwise generates it and rewrites the snapshot
+  void initSpectrum();
+  // Lays h0_k_ out as h0Paired_ in the bin order of h_kt_
+  void buildPairedSpectrum();
+  void generateH_KT_Spectrum(double t);
   void generateHeightField();
+  // Row ranges of the two passes around the FFT, shared by the thread pool
+  // and the frame graph
+  void evolveRows(double t, int rowBegin, int rowEnd);
+  void packRows(int rowBegin, int rowEnd);
+  void uploadFields(const void *fields);
+  // Narrows h0Paired_ into h0Half_ and releases it
+  void storeHalfSpectrum();
   void saveAsImage(float brightnessScale, int option = 0);
-  void saveHeightFieldAsImage(fftwf_complex *heightField);
+  void saveHeightFieldAsImage(const float *heightField);
   void createSurface();
+  // Fills the staging buffer with the fields at time t (CPU only)
+  void simulate(double t);
+  // simulate(t) with every pass on `pool` (the FFT as its column and row
+  // passes, like the frame graph), adding the seconds of the evolve, FFT
+  // and pack passes to seconds[0], [1] and [2]
+  void simulateTimed(ThreadPool &pool, double t, double seconds[3]);
+  // The same work as tasks in a frame graph, after the tasks in `after`.
+  // Returns the task that finishes once fields() holds the result. Task names
+  // start with `label`.
+  TaskId addSimulationTasks(FrameGraph &graph, double t,
+                            TaskList after = {}, const char *label = "");
+  // Advances the clock and adds this frame's simulation and upload; render()
+  // once the graph has run
+  void scheduleFrame(FrameGraph &graph);
+  void advanceClock();
   void update();
+
+  // Moves spectrum, FFT and post pass to their own thread; update() then
+  // only uploads the latest completed frame and never waits for the
+  // simulation. Setters that touch the spectrum, its tables or buffers
+  // (setConfig, setGravity, setDispersion, setFixedTimeStep,
+  // setHalfPrecision, setLoopPeriod, bakeLoop, loadLoop) stop the thread
+  // while they run and restart it.
+  void startAsyncSimulation();
+  void stopAsyncSimulation();
+  void simulationLoop();
   void render();
+
+  // Heights of the latest completed frame at positions (x, z) of this
+  // ocean's surface (the rendered space, before the model matrix) in world
+  // units, for as many positions as both spans hold. Bilinear matches what
+  // is rendered at the undisplaced texel positions. Callable from any
+  // thread while the simulation runs; false before the first frame.
+  bool sampleHeights(std::span<const glm::vec2> positions,
+                     std::span<float> heights,
+                     HeightFilter filter = HEIGHT_FILTER_BILINEAR) const {
+    return heightStore.acquire().sample(positions, heights, filter);
+  }
+  // Pins the latest completed frame, for several batches against it
+  HeightSnapshot heightSnapshot() const { return heightStore.acquire(); }
+  // Direct sum of the `bins` strongest bins of h0 at any (x, z, t), in the
+  // positions and units of sampleHeights; independent of the frame loop
+  // and of this Wave once built
+  SparseOcean createSparseOcean(int bins) const;
+
+  int size() const { return N; }
+  float patchSize() const { return L; }
+  // N x N RGBA (Dx, height, Dz, J) then N x N RG slopes, see simulate(),
+  // as floats or halves
+  const void *fields() const { return fields_; }
+  GLenum fieldType() const { return halfPrecision ? GL_HALF_FLOAT : GL_FLOAT; }
+  bool usesHalfPrecision() const { return halfPrecision; }
 };
 
+// Times the evolve, FFT and pack passes of 256 to 2048 sized Waves on pools
+// of 1 up to one thread per hardware thread and prints the ms per pass and
+// the speedup over one thread, the scaling report of the worker pool
+void benchmarkThreadScaling();
+
+// Simulates an n x n Wave with the full complex spectrum (FFT_COMPLEX) and
+// with the Hermitian half spectrum (FFT_HALF_COMPLEX) from the same h0 at
+// time t and prints the largest difference of every field channel; false
+// if any is beyond float rounding
+bool verifyHalfSpectrumFFT(int n, double t = 12.5);
+
+// Simulates an n x n Wave in fp32 and in fp16 storage mode and prints the
+// bytes each moves per frame, their cost and the largest fp16 error of every
+// field channel
+void benchmarkHalfPrecision(int n);
+
+// Compares SparseOceans of increasing size with an n x n Wave's FFT heights
+// and prints their measured error, error bound and cost per query
+void benchmarkSparseOcean(int n);
+
 #endif
\ No newline at end of file